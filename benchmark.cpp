@@ -0,0 +1,332 @@
+#include <hl/silva/collections/serialization.hpp>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <functional>
+
+// Serialization throughput benchmark
+//
+// g++ -std=c++17 -O2 -I. benchmark.cpp -o benchmark
+// ./benchmark [--json] [--min-time <ms>] [--filter <substring>] [--all-formats]
+//
+// Every case is run for a sweep of payload sizes, encode measures serializing the values and building
+// the archive (serialized_buffer), decode measures reset + reading the values back into reused objects.
+
+namespace serialization = hl::silva::collections::serialization;
+namespace metadata = hl::silva::collections::serialization::metadata;
+
+template<typename T>
+static inline void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct options_t
+{
+    bool json = false;
+    bool all_formats = false;
+    double min_time_ms = 100.0;
+    std::string filter;
+};
+
+struct result_t
+{
+    std::string name;
+    std::string format;
+    std::size_t payload_bytes;  // size of the values as they are in memory
+    std::size_t message_bytes;  // size of the archive
+    double encode_ns;           // per message
+    double decode_ns;           // per message
+};
+
+struct format_t
+{
+    std::string name;
+    metadata::archive_format format;
+};
+
+// a case serializes one message made of values depending on the sweep parameter and reads it back
+struct case_t
+{
+    std::string name;
+    std::vector<std::size_t> sweep;
+    std::function<std::size_t(std::size_t)> payload_bytes;
+    std::function<void(serialization::serializer&, std::size_t)> encode;
+    std::function<void(serialization::deserializer&, std::size_t)> decode;
+};
+
+// runs body in batches until min_time_ms has elapsed, returns the ns per call
+template<typename Body>
+static double measure_ns(const options_t& options, Body&& body)
+{
+    using clock = std::chrono::steady_clock;
+
+    std::size_t iterations = 0;
+    std::size_t batch = 1;
+    const clock::time_point start = clock::now();
+    double elapsed_ms = 0;
+
+    do
+    {
+        for (std::size_t i = 0; i < batch; i++)
+        {
+            body();
+        }
+        iterations += batch;
+        batch *= 2;
+        elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    } while (elapsed_ms < options.min_time_ms);
+
+    return elapsed_ms * 1e6 / iterations;
+}
+
+static std::vector<case_t> make_cases()
+{
+    std::vector<case_t> cases;
+
+    cases.push_back(case_t {
+        "small_ints",
+        { 4, 16, 64, 256 },
+        [](std::size_t n) { return n * (sizeof(u8) + sizeof(u16) + sizeof(u32) + sizeof(u64)); },
+        [](serialization::serializer& s, std::size_t n) {
+            for (std::size_t i = 0; i < n; i++)
+            {
+                s << u8(i) << u16(i * 3) << u32(i * 7) << u64(i * 11);
+            }
+        },
+        [](serialization::deserializer& d, std::size_t n) {
+            u8 a; u16 b; u32 c; u64 e;
+            for (std::size_t i = 0; i < n; i++)
+            {
+                d >> a >> b >> c >> e;
+                do_not_optimize(e);
+            }
+        }
+    });
+
+    cases.push_back(case_t {
+        "long_string",
+        { 16, 256, 4096, 65536 },
+        [](std::size_t n) { return n; },
+        [](serialization::serializer& s, std::size_t n) {
+            static std::string value;
+            if (value.size() != n)
+            {
+                value.assign(n, 'x'); // only when the sweep moves on, not part of the measure
+            }
+            s << value;
+        },
+        [](serialization::deserializer& d, std::size_t) {
+            static std::string value;
+            d >> value;
+            do_not_optimize(value);
+        }
+    });
+
+    cases.push_back(case_t {
+        "byte_blob",
+        { 16, 256, 4096, 65536 },
+        [](std::size_t n) { return n; },
+        [](serialization::serializer& s, std::size_t n) {
+            static serialization::byte_vector value;
+            if (value.size() != n)
+            {
+                value.assign(n, 0xA5);
+            }
+            s << value;
+        },
+        [](serialization::deserializer& d, std::size_t) {
+            static serialization::byte_vector value;
+            d >> value;
+            do_not_optimize(value);
+        }
+    });
+
+    cases.push_back(case_t {
+        "u32_container",
+        { 16, 256, 4096, 65536 },
+        [](std::size_t n) { return n * sizeof(u32); },
+        [](serialization::serializer& s, std::size_t n) {
+            static std::vector<u32> value;
+            value.resize(n, 42);
+            s.serialize_container(value);
+        },
+        [](serialization::deserializer& d, std::size_t) {
+            static std::vector<u32> value;
+            d.get_container_inplace(value);
+            do_not_optimize(value);
+        }
+    });
+
+    cases.push_back(case_t {
+        "mixed_type_value",
+        { 4, 16, 64, 256 },
+        [](std::size_t n) { return n * (sizeof(u32) + sizeof(i64) + 12); },
+        [](serialization::serializer& s, std::size_t n) {
+            static const std::string text = "hello world!";
+            for (std::size_t i = 0; i < n; i++)
+            {
+                s << u32(i) << i64(-(i64)i) << text;
+            }
+        },
+        [](serialization::deserializer& d, std::size_t) {
+            // the generic path: every value is decoded into a type_value
+            metadata::type_value value;
+            do
+            {
+                d >> value;
+                do_not_optimize(value);
+            } while (!std::holds_alternative<std::nullptr_t>(value));
+        }
+    });
+
+    return cases;
+}
+
+static std::vector<format_t> make_formats(const options_t& options)
+{
+    std::vector<format_t> formats = { { "native", metadata::archive_format() } };
+
+    if (options.all_formats)
+    {
+        const hl::silva::collections::bit::endian swapped = hl::silva::collections::bit::endian::native == hl::silva::collections::bit::endian::little
+            ? hl::silva::collections::bit::endian::big
+            : hl::silva::collections::bit::endian::little;
+
+        formats.push_back({ "swapped", metadata::archive_format(swapped) });
+        formats.push_back({ "aligned", metadata::archive_format(metadata::field_layout::ALIGNED) });
+        formats.push_back({ "compact", metadata::archive_format(metadata::header_kind::COMPACT) });
+    }
+    return formats;
+}
+
+static result_t run_case(const options_t& options, const case_t& c, const format_t& format, std::size_t n)
+{
+    serialization::serializer serializer(metadata::magic_number(), format.format);
+    serialization::deserializer deserializer;
+    serialization::byte_vector rest_buffer;
+    serialization::byte_vector message;
+
+    const double encode_ns = measure_ns(options, [&]() {
+        serializer.clear();
+        c.encode(serializer, n);
+        message = serializer.serialized_buffer();
+        do_not_optimize(message);
+    });
+
+    const double decode_ns = measure_ns(options, [&]() {
+        deserializer.reset(message, rest_buffer);
+        c.decode(deserializer, n);
+    });
+
+    return result_t { c.name + "/" + std::to_string(n), format.name, c.payload_bytes(n), message.size(), encode_ns, decode_ns };
+}
+
+static double mb_per_s(std::size_t bytes, double ns)
+{
+    return bytes / ns * 1e9 / (1024.0 * 1024.0);
+}
+
+static void print_text(const std::vector<result_t>& results)
+{
+    std::printf("%-28s %-8s %10s %12s %12s %12s %12s\n", "case", "format", "bytes", "enc ns/msg", "enc MB/s", "dec ns/msg", "dec MB/s");
+
+    for (const result_t& r : results)
+    {
+        std::printf("%-28s %-8s %10zu %12.1f %12.1f %12.1f %12.1f\n", r.name.c_str(), r.format.c_str(), r.message_bytes,
+            r.encode_ns, mb_per_s(r.message_bytes, r.encode_ns), r.decode_ns, mb_per_s(r.message_bytes, r.decode_ns));
+    }
+}
+
+static void print_json(const std::vector<result_t>& results, const options_t& options)
+{
+    std::printf("{\n  \"context\": { \"compiler\": \"%s\", \"cplusplus\": %ld, \"min_time_ms\": %.1f },\n  \"benchmarks\": [\n",
+#if defined(__clang__)
+        "clang " __clang_version__,
+#elif defined(__GNUC__)
+        "gcc " __VERSION__,
+#else
+        "unknown",
+#endif
+        (long)__cplusplus, options.min_time_ms);
+
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        const result_t& r = results[i];
+
+        std::printf("    { \"name\": \"%s\", \"format\": \"%s\", \"payload_bytes\": %zu, \"message_bytes\": %zu, "
+            "\"encode_ns_per_message\": %.2f, \"encode_mb_per_s\": %.2f, \"decode_ns_per_message\": %.2f, \"decode_mb_per_s\": %.2f }%s\n",
+            r.name.c_str(), r.format.c_str(), r.payload_bytes, r.message_bytes,
+            r.encode_ns, mb_per_s(r.message_bytes, r.encode_ns), r.decode_ns, mb_per_s(r.message_bytes, r.decode_ns),
+            i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+    options_t options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+
+        if (arg == "--json")
+        {
+            options.json = true;
+        }
+        else if (arg == "--all-formats")
+        {
+            options.all_formats = true;
+        }
+        else if (arg == "--min-time" && i + 1 < argc)
+        {
+            options.min_time_ms = std::stod(argv[++i]);
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+        {
+            options.filter = argv[++i];
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--json] [--min-time <ms>] [--filter <substring>] [--all-formats]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<result_t> results;
+
+    for (const format_t& format : make_formats(options))
+    {
+        for (const case_t& c : make_cases())
+        {
+            for (std::size_t n : c.sweep)
+            {
+                if (!options.filter.empty() && (c.name + "/" + std::to_string(n)).find(options.filter) == std::string::npos)
+                {
+                    continue;
+                }
+                results.push_back(run_case(options, c, format, n));
+            }
+        }
+    }
+
+    if (options.json)
+    {
+        print_json(results, options);
+    }
+    else
+    {
+        print_text(results);
+    }
+
+    return 0;
+}
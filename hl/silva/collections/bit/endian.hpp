@@ -263,6 +263,32 @@ HL_CONSTEXPR_STATIC_INLINE_FUNCTION void network_to_native_inplace(T &value)
     value = network_to_native(value);
 }
 
+/**
+ * @brief Transform a native value to the given endian
+ * @tparam T The type of the value
+ * @param value The value to transform
+ * @param order The endian to transform to (known only at runtime)
+ * @retval T The value in the given endian
+ */
+template<typename T, meta::is_arithmetic<T> = true>
+HL_CONSTEXPR_STATIC_INLINE_FUNCTION T to_endian(const T &value, const endian &order)
+{
+    return order == endian::native ? value : swap_endian(value);
+}
+
+/**
+ * @brief Transform a value in the given endian to native
+ * @tparam T The type of the value
+ * @param value The value to transform
+ * @param order The endian the value is in (known only at runtime)
+ * @retval T The value in native endian
+ */
+template<typename T, meta::is_arithmetic<T> = true>
+HL_CONSTEXPR_STATIC_INLINE_FUNCTION T from_endian(const T &value, const endian &order)
+{
+    return to_endian(value, order); // same as network_to_native, swapping is symmetrical
+}
+
 }
 }
 }
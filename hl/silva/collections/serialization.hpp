@@ -24,15 +24,29 @@
 #pragma once
 
 // u8*4            u64         u8         rodata       u8        rodata
-// [magic number]  [size] [[typechartdata]data[0],    [typechart]data[1], ...]
+// [magic number]  [flags|size] [[typechartdata]data[0],    [typechart]data[1], ...]
 // String: [STRING_TYPE][size][data]
 // Array: [BYTE_ARRAY_TYPE][size][data]
+// Typed array: [TYPED_ARRAY_TYPE][element type][count][count * sizeof(element) data]
+// Record: [RECORD_TYPE][byte length][nested values, without END marker]
 // Other: [TYPE][data]
-// All sizes and types that validate std::is_arithmetic_v<T> are in network byte order
+// The header is in network byte order, its most significant byte holds the flags (see metadata::HEADER_FLAG_*)
+// Compact header (metadata::header_kind::COMPACT, PACKED only): [magic tag u8][varint(size << 1 | little endian)]
+// All sizes and types of the body that validate std::is_arithmetic_v<T> are in the byte order given by the flags
+// (big endian when HEADER_FLAG_LITTLE_ENDIAN is not set)
+// With HEADER_FLAG_ALIGNED zero padding follows each type chart so that the payload (or the size of arrays)
+// is at an offset, from the first byte of the archive, multiple of its size (8 for the size of arrays)
+// PADDING type charts (no data) may precede a value of an aligned archive, they are skipped when decoding
 
 #if __cplusplus >= 201703L
+#include <hl/silva/collections/serialization/archive.hpp>
+#include <hl/silva/collections/serialization/async_deserializer.hpp>
+#include <hl/silva/collections/serialization/buffer_pool.hpp>
+#include <hl/silva/collections/serialization/containers.hpp>
 #include <hl/silva/collections/serialization/deserializer.hpp>
+#include <hl/silva/collections/serialization/measure.hpp>
 #include <hl/silva/collections/serialization/serializer.hpp>
+#include <hl/silva/collections/serialization/utf8.hpp>
 #else
 #error "C++17 or higher is required for this library"
 #endif
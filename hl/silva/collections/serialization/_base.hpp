@@ -29,6 +29,8 @@
 #include <hl/silva/collections/meta.hpp>
 
 #include <vector>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <array>
 #include <string>
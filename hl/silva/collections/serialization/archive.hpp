@@ -0,0 +1,199 @@
+/**
+ * hl/silva/collections/serialization/archive.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/serialization/metadata.hpp>
+
+// Archive level operations working on serialized buffers without decoding the values:
+// only the headers and END markers are rewritten, the values are copied as raw bytes
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace serialization
+{
+namespace archive
+{
+
+/**
+ * @brief body A view over the values of a serialized archive (without header and END marker)
+ */
+struct body
+{
+    serialization::metadata::archive_format format;
+    serialization::metadata::size_type begin;  // offset of the first value (the header length)
+    serialization::metadata::size_type end;    // offset of the END marker
+};
+
+/**
+ * @brief Locate the values of an archive
+ * @param buffer The serialized archive (trailing bytes after the archive are ignored)
+ * @param expected_magic The magic number the archive must have
+ */
+static inline body load_body(const byte_vector& buffer,
+    const serialization::metadata::magic_number& expected_magic=serialization::metadata::magic_number())
+{
+    body result;
+    serialization::metadata::header_size_type size;
+
+    result.begin = serialization::metadata::decode_header(buffer.data(), buffer.size(), expected_magic, size, result.format);
+
+    if (result.begin == 0 || size < serialization::metadata::TYPE_CHART_SIZE || size > buffer.size() - result.begin)
+    {
+        throw error("Buffer is too small to contain the data");
+    }
+
+    result.end = result.begin + size - serialization::metadata::TYPE_CHART_SIZE;
+
+    if (buffer[result.end] != serialization::metadata::type_chart::END)
+    {
+        throw error("Missing END marker");
+    }
+
+    return result;
+}
+
+// Number of PADDING bytes to insert so that values of an ALIGNED body copied from offset to new_offset
+// are moved by a multiple of 8 bytes (the biggest alignment) and keep matching their padding
+static inline serialization::metadata::size_type _realign_padding(const body& from, const serialization::metadata::size_type& new_offset)
+{
+    if (!from.format.is_aligned())
+    {
+        return 0;
+    }
+    return (from.begin - new_offset) % sizeof(stdint::u64);
+}
+
+/**
+ * @brief Write an archive made of the header, values copied from bodies and the END marker
+ */
+static inline void _write(byte_vector& out,
+    const serialization::metadata::magic_number& magic,
+    const serialization::metadata::archive_format& format,
+    const std::vector<std::pair<const byte_vector*, body>>& bodies)
+{
+    serialization::metadata::size_type size = serialization::metadata::TYPE_CHART_SIZE;
+
+    // ALIGNED archives always have a FULL header
+    for (const auto& it : bodies)
+    {
+        size += _realign_padding(it.second, serialization::metadata::HEADER_SIZE + size - serialization::metadata::TYPE_CHART_SIZE);
+        size += it.second.end - it.second.begin;
+    }
+
+    serialization::metadata::header_byte_array header;
+    const serialization::metadata::size_type header_size = serialization::metadata::encode_header(header, magic, size, format);
+
+    out.clear();
+    out.reserve(header_size + size);
+    out.insert(out.end(), header.begin(), header.begin() + header_size);
+
+    for (const auto& it : bodies)
+    {
+        out.insert(out.end(), _realign_padding(it.second, out.size()), serialization::metadata::type_chart::PADDING);
+        out.insert(out.end(), it.first->begin() + it.second.begin, it.first->begin() + it.second.end);
+    }
+
+    out.push_back(serialization::metadata::type_chart::END);
+}
+
+/**
+ * @brief Concatenate the values of several archives into a single one (the content of out is replaced)
+ * @param archives The archives, they must all have the same magic number and format
+ * @param out Where to write the resulting archive (its capacity is reused)
+ * @param magic The magic number of the archives
+ */
+static inline void concatenate(const std::vector<byte_vector>& archives, byte_vector& out,
+    const serialization::metadata::magic_number& magic=serialization::metadata::magic_number())
+{
+    std::vector<std::pair<const byte_vector*, body>> bodies;
+    bodies.reserve(archives.size());
+
+    for (const byte_vector& archive : archives)
+    {
+        bodies.emplace_back(&archive, load_body(archive, magic));
+
+        if (bodies.back().second.format != bodies.front().second.format)
+        {
+            throw error("Cannot concatenate archives of different formats");
+        }
+    }
+
+    _write(out, magic, bodies.empty() ? serialization::metadata::archive_format() : bodies.front().second.format, bodies);
+}
+
+static inline byte_vector concatenate(const std::vector<byte_vector>& archives,
+    const serialization::metadata::magic_number& magic=serialization::metadata::magic_number())
+{
+    byte_vector out;
+    concatenate(archives, out, magic);
+    return out;
+}
+
+/**
+ * @brief Extract a range of values of an archive into a new archive (the content of out is replaced)
+ * @param archive The archive to slice
+ * @param first The index of the first value to keep
+ * @param count The number of values to keep (stops at the end of the archive)
+ * @param out Where to write the resulting archive (its capacity is reused)
+ * @param magic The magic number of the archive
+ * @details Values are skipped from their type chart and size only, they are never decoded
+ */
+static inline void slice(const byte_vector& archive, stdint::size_t first, stdint::size_t count, byte_vector& out,
+    const serialization::metadata::magic_number& magic=serialization::metadata::magic_number())
+{
+    body range = load_body(archive, magic);
+
+    for (; first > 0 && range.begin < range.end; first--)
+    {
+        range.begin = serialization::metadata::field_end(archive, range.begin, range.end, range.format);
+    }
+
+    serialization::metadata::size_type end = range.begin;
+
+    for (; count > 0 && end < range.end; count--)
+    {
+        end = serialization::metadata::field_end(archive, end, range.end, range.format);
+    }
+    range.end = end;
+
+    _write(out, magic, range.format, { { &archive, range } });
+}
+
+static inline byte_vector slice(const byte_vector& archive, stdint::size_t first, stdint::size_t count,
+    const serialization::metadata::magic_number& magic=serialization::metadata::magic_number())
+{
+    byte_vector out;
+    slice(archive, first, count, out, magic);
+    return out;
+}
+
+}
+}
+}
+}
+}
@@ -0,0 +1,489 @@
+/**
+ * hl/silva/collections/serialization/async_deserializer.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/serialization/metadata.hpp>
+
+// Only available with C++20 coroutines, the header is empty otherwise
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#define SILVA_SERIALIZATION_HAS_ASYNC_DESERIALIZER 1
+
+#include <coroutine>
+#include <optional>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace serialization
+{
+
+/**
+ * @brief async_deserializer A deserializer fed chunk by chunk whose reads are awaitable
+ * @details co_await d.read_u32() completes immediately when the value is already buffered,
+ *          otherwise the coroutine is suspended and resumed by the feed() call that completes
+ *          the value (on the thread calling feed()). Only one read can be pending at a time.
+ *          The archive has the same format as the one read by deserializer, its header is
+ *          loaded by the first read.
+ */
+class async_deserializer : public meta::NonCopyMoveable
+{
+private:
+    byte_vector m_buffer;
+    stdint::size_t m_index = 0;     // offset of the next value
+    stdint::size_t m_end = 0;       // offset after the END marker once the header is loaded
+
+    serialization::metadata::magic_number m_expected_magic;
+    serialization::metadata::archive_format m_format;
+    bool m_header_loaded = false;
+    bool m_closed = false;
+
+    std::coroutine_handle<> m_waiting;
+    std::optional<error> m_error; // error raised while checking the pending read from feed()
+
+    // returns false while the whole header has not been received
+    bool _load_header()
+    {
+        serialization::metadata::header_size_type size;
+        const stdint::size_t header_size = serialization::metadata::decode_header(m_buffer.data(), m_buffer.size(), m_expected_magic, size, m_format);
+
+        if (header_size == 0)
+        {
+            return false;
+        }
+        else if (size < serialization::metadata::TYPE_CHART_SIZE)
+        {
+            throw error("Buffer is too small to contain the data");
+        }
+
+        m_index = header_size;
+        m_end = m_index + size;
+        m_header_loaded = true;
+        return true;
+    }
+
+    // number of bytes the buffer must hold to know (and then to contain) the whole value at m_index
+    stdint::size_t _required_size() const
+    {
+        stdint::size_t index = m_index;
+
+        while (index < m_buffer.size() && m_buffer[index] == serialization::metadata::type_chart::PADDING)
+        {
+            index++;
+        }
+
+        if (index + serialization::metadata::TYPE_CHART_SIZE > m_buffer.size())
+        {
+            return index + serialization::metadata::TYPE_CHART_SIZE;
+        }
+
+        const serialization::metadata::type_chart type = (serialization::metadata::type_chart)m_buffer[index];
+        stdint::size_t offset = index + serialization::metadata::TYPE_CHART_SIZE;
+        stdint::size_t element_size = 1;
+
+        switch (type)
+        {
+            case serialization::metadata::type_chart::END:
+                return offset;
+
+            case serialization::metadata::type_chart::STRING:
+            case serialization::metadata::type_chart::BYTE_ARRAY:
+            case serialization::metadata::type_chart::RECORD:
+                break;
+
+            case serialization::metadata::type_chart::TYPED_ARRAY:
+                if (offset + serialization::metadata::TYPE_CHART_SIZE > m_buffer.size())
+                {
+                    return offset + serialization::metadata::TYPE_CHART_SIZE;
+                }
+                element_size = serialization::metadata::type_chart_size((serialization::metadata::type_chart)m_buffer[offset]);
+                offset += serialization::metadata::TYPE_CHART_SIZE;
+                if (element_size == 0)
+                {
+                    throw error("Invalid typed array element type");
+                }
+                break;
+
+            default:
+            {
+                const stdint::size_t size = serialization::metadata::type_chart_size(type);
+
+                if (size == 0)
+                {
+                    throw error("Unknown type??");
+                }
+                return m_format.payload_offset(offset, size) + size;
+            }
+        }
+
+        offset = m_format.payload_offset(offset, serialization::metadata::SIZE_TYPE_SIZE);
+
+        if (offset + serialization::metadata::SIZE_TYPE_SIZE > m_buffer.size())
+        {
+            return offset + serialization::metadata::SIZE_TYPE_SIZE;
+        }
+
+        serialization::metadata::size_type count;
+        std::memcpy(&count, &m_buffer[offset], serialization::metadata::SIZE_TYPE_SIZE);
+        count = bit::from_endian(count, m_format.byte_order);
+        offset += serialization::metadata::SIZE_TYPE_SIZE;
+
+        if (count > (m_end - std::min<stdint::size_t>(offset, m_end)) / element_size)
+        {
+            throw error("Value goes past the end of the archive");
+        }
+        return offset + count * element_size;
+    }
+
+    // whether the whole next value is buffered (loads the header first)
+    bool _value_ready()
+    {
+        if (!m_header_loaded && !_load_header())
+        {
+            return false;
+        }
+
+        if (m_index >= m_end)
+        {
+            throw error("No value left in the archive");
+        }
+
+        const stdint::size_t required = _required_size();
+
+        if (required > m_end)
+        {
+            throw error("Value goes past the end of the archive");
+        }
+        return required <= m_buffer.size();
+    }
+
+    template<typename T>
+    T _read_payload(stdint::size_t& index, const stdint::size_t& end) const
+    {
+        index = m_format.payload_offset(index, sizeof(T));
+
+        if (index + sizeof(T) > end)
+        {
+            throw error("Buffer is too small to contain the value");
+        }
+
+        T value;
+        std::memcpy(&value, &m_buffer[index], sizeof(T));
+        index += sizeof(T);
+        return bit::from_endian(value, m_format.byte_order);
+    }
+
+    // decodes the (fully buffered) value at index, records are decoded recursively
+    serialization::metadata::type_value _decode(stdint::size_t& index, const stdint::size_t& end) const
+    {
+        while (index < end && m_buffer[index] == serialization::metadata::type_chart::PADDING)
+        {
+            index++;
+        }
+
+        if (index + serialization::metadata::TYPE_CHART_SIZE > end)
+        {
+            throw error("Buffer is too small to contain the value");
+        }
+
+        const serialization::metadata::type_chart type = (serialization::metadata::type_chart)m_buffer[index];
+        index += serialization::metadata::TYPE_CHART_SIZE;
+
+        switch (type)
+        {
+            #define SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(TYPE, CTYPE) \
+            case serialization::metadata::type_chart::TYPE: \
+                return _read_payload<CTYPE>(index, end);
+
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(U8, stdint::u8);
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(U16, stdint::u16);
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(U32, stdint::u32);
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(U64, stdint::u64);
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(I8, stdint::i8);
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(I16, stdint::i16);
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(I32, stdint::i32);
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(I64, stdint::i64);
+            SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC(BOOL8, stdint::bool8);
+
+            #undef SILVA_ASYNC_DESERIALIZER_CASE_ARITHMETIC
+
+            case serialization::metadata::type_chart::STRING:
+            case serialization::metadata::type_chart::BYTE_ARRAY:
+            {
+                const serialization::metadata::size_type size = _read_payload<serialization::metadata::size_type>(index, end);
+
+                if (size > end - index)
+                {
+                    throw error("Buffer is too small to contain the value");
+                }
+
+                const stdint::byte* data = m_buffer.data() + index;
+                index += size;
+
+                if (type == serialization::metadata::type_chart::STRING)
+                {
+                    return std::string((const char*)data, size);
+                }
+                return byte_vector(data, data + size);
+            }
+
+            case serialization::metadata::type_chart::TYPED_ARRAY:
+            {
+                serialization::metadata::typed_array value;
+
+                if (index + serialization::metadata::TYPE_CHART_SIZE > end)
+                {
+                    throw error("Buffer is too small to contain the value");
+                }
+                value.element_type = m_buffer[index];
+                index += serialization::metadata::TYPE_CHART_SIZE;
+
+                const stdint::size_t element_size = serialization::metadata::type_chart_size((serialization::metadata::type_chart)value.element_type);
+                const serialization::metadata::size_type count = _read_payload<serialization::metadata::size_type>(index, end);
+
+                if (element_size == 0 || count > (end - index) / element_size)
+                {
+                    throw error("Buffer is too small to contain the value");
+                }
+
+                value.data.resize(count * element_size);
+                serialization::metadata::copy_elements(value.data.data(), &m_buffer[index], count, element_size, m_format.needs_swap());
+                index += count * element_size;
+                return value;
+            }
+
+            case serialization::metadata::type_chart::RECORD:
+            {
+                const serialization::metadata::size_type length = _read_payload<serialization::metadata::size_type>(index, end);
+
+                if (length > end - index)
+                {
+                    throw error("Record is bigger than its container");
+                }
+
+                const stdint::size_t record_end = index + length;
+
+                serialization::metadata::record value;
+                while (index < record_end)
+                {
+                    value.fields.push_back(_decode(index, record_end));
+                }
+                if (index != record_end)
+                {
+                    throw error("Record field goes past the end of the record");
+                }
+                return value;
+            }
+
+            case serialization::metadata::type_chart::END:
+                return nullptr;
+
+            default:
+                throw error("Unknown type??");
+        }
+    }
+
+    template<typename T>
+    T _take()
+    {
+        if (m_error)
+        {
+            error e = std::move(*m_error);
+            m_error.reset();
+            throw e;
+        }
+        else if (!_value_ready())
+        {
+            throw error("Archive stream closed before the value was complete");
+        }
+
+        stdint::size_t index = m_index;
+        serialization::metadata::type_value value = _decode(index, m_end);
+
+        HL_IF_CONSTEXPR (std::is_same<T, serialization::metadata::type_value>::value)
+        {
+            m_index = index;
+            return value;
+        }
+        else
+        {
+            T* result = std::get_if<T>(&value);
+
+            if (result == nullptr)
+            {
+                throw error("Type does not match the expected type");
+            }
+            m_index = index;
+            return std::move(*result);
+        }
+    }
+
+public:
+    /**
+     * @brief read_awaitable The awaitable returned by the read_* functions, co_await gives the value
+     */
+    template<typename T>
+    class read_awaitable
+    {
+    private:
+        async_deserializer& _deserializer;
+
+    public:
+        read_awaitable(async_deserializer& deserializer)
+            : _deserializer(deserializer)
+        {}
+
+        bool await_ready()
+        {
+            return _deserializer.m_closed || _deserializer._value_ready();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            if (_deserializer.m_waiting)
+            {
+                throw error("Only one read can be pending on an async_deserializer");
+            }
+            _deserializer.m_waiting = handle;
+        }
+
+        T await_resume()
+        {
+            return _deserializer._take<T>();
+        }
+    };
+
+    async_deserializer(const serialization::metadata::magic_number& expected_magic=serialization::metadata::magic_number())
+        : m_expected_magic(expected_magic)
+    {}
+
+    virtual ~async_deserializer() override = default;
+
+    /**
+     * @brief Append bytes received from the source, resumes the pending read if its value is now complete
+     */
+    void feed(const stdint::byte* data, stdint::size_t size)
+    {
+        m_buffer.insert(m_buffer.end(), data, data + size);
+
+        if (!m_waiting)
+        {
+            return;
+        }
+
+        try
+        {
+            if (!_value_ready())
+            {
+                return;
+            }
+        }
+        catch (const error& e)
+        {
+            m_error = e; // thrown by the pending read
+        }
+
+        std::coroutine_handle<> handle = m_waiting;
+        m_waiting = nullptr;
+        handle.resume();
+    }
+
+    void feed(const byte_vector& data)
+    {
+        feed(data.data(), data.size());
+    }
+
+    /**
+     * @brief Signal that the source will not deliver more bytes, the pending read throws if its value is incomplete
+     */
+    void close()
+    {
+        m_closed = true;
+
+        if (m_waiting)
+        {
+            std::coroutine_handle<> handle = m_waiting;
+            m_waiting = nullptr;
+            handle.resume();
+        }
+    }
+
+    /**
+     * @brief Drop the archive that has been read (up to its END marker) to read the next one from the same source
+     * @details The bytes already received for the next archive are kept
+     */
+    void next_archive()
+    {
+        if (!m_header_loaded || m_index != m_end)
+        {
+            throw error("The current archive has not been read up to its END marker");
+        }
+
+        m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_end);
+        m_index = 0;
+        m_end = 0;
+        m_header_loaded = false;
+    }
+
+#define SILVA_ASYNC_DESERIALIZER_READ(CTYPE, FUNC_NAME) \
+    read_awaitable<CTYPE> read_##FUNC_NAME() { return read_awaitable<CTYPE>(*this); }
+
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::u8,     u8);
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::u16,    u16);
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::u32,    u32);
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::u64,    u64);
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::i8,     i8);
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::i16,    i16);
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::i32,    i32);
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::i64,    i64);
+    SILVA_ASYNC_DESERIALIZER_READ(stdint::bool8,  bool8);
+    SILVA_ASYNC_DESERIALIZER_READ(std::string,    string);
+    SILVA_ASYNC_DESERIALIZER_READ(byte_vector,    byte_array);
+    SILVA_ASYNC_DESERIALIZER_READ(serialization::metadata::typed_array, typed_array);
+    SILVA_ASYNC_DESERIALIZER_READ(serialization::metadata::record,      record);
+
+    // nullptr when the END marker is read
+    SILVA_ASYNC_DESERIALIZER_READ(serialization::metadata::type_value,  type_value);
+
+#undef SILVA_ASYNC_DESERIALIZER_READ
+
+    bool is_at_end() const
+    {
+        return m_header_loaded && m_index == m_end;
+    }
+
+    const serialization::metadata::archive_format& get_format() const
+    {
+        return m_format;
+    }
+};
+
+}
+}
+}
+}
+
+#endif
@@ -0,0 +1,239 @@
+/**
+ * hl/silva/collections/serialization/buffer_pool.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/serialization/_base.hpp>
+#include <hl/silva/collections/thread_safe/_base.hpp>
+
+#include <atomic>
+
+#ifndef SILVA_SERIALIZER_BUFFER_POOL_DEFAULT_MAX_RETAINED_BYTES
+#define SILVA_SERIALIZER_BUFFER_POOL_DEFAULT_MAX_RETAINED_BYTES (16 * 1024 * 1024)
+#endif
+
+#ifndef SILVA_SERIALIZER_BUFFER_POOL_MIN_CAPACITY_CLASS
+#define SILVA_SERIALIZER_BUFFER_POOL_MIN_CAPACITY_CLASS 6 // 64 bytes
+#endif
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace serialization
+{
+
+/**
+ * @brief buffer_pool A thread safe pool of byte_vector recycled by capacity class
+ * @details Buffers are stored in power of two buckets: a buffer released with a capacity
+ *          of c goes to the bucket floor(log2(c)) so that every buffer of the bucket k
+ *          can hold at least 2^k bytes, acquiring n bytes takes a buffer from the smallest
+ *          non-empty bucket from ceil(log2(n)) up so that grown buffers are handed out again.
+ *          Released buffers that would make the pool retain more than max_retained_bytes
+ *          are freed instead of being kept.
+ */
+class buffer_pool : public meta::NonCopyMoveable
+{
+public:
+    using size_type = stdint::size_t;
+
+    /**
+     * @brief statistics A snapshot of the counters of the pool
+     */
+    struct statistics
+    {
+        stdint::u64 hits;           // acquire served by a recycled buffer
+        stdint::u64 misses;         // acquire that had to allocate a new buffer
+        stdint::u64 releases;       // buffers kept by the pool on release
+        stdint::u64 drops;          // buffers freed on release because of the retained cap
+        size_type retained_bytes;   // capacity currently owned by the pool
+    };
+
+    HL_INLINE_CONSTEXPR_VARIABLE size_type CAPACITY_CLASS_COUNT = sizeof(size_type) * 8;
+
+private:
+    std::array<std::vector<byte_vector>, CAPACITY_CLASS_COUNT> m_buckets;
+    size_type m_retained_bytes = 0;
+    size_type m_size_hint = 0;
+    const size_type m_max_retained_bytes;
+    mutable thread_safe::mutex m_mutex;
+
+    std::atomic<stdint::u64> m_hits;
+    std::atomic<stdint::u64> m_misses;
+    std::atomic<stdint::u64> m_releases;
+    std::atomic<stdint::u64> m_drops;
+
+    static size_type _floor_class(size_type capacity)
+    {
+        size_type capacity_class = 0;
+        while (capacity >>= 1)
+        {
+            capacity_class++;
+        }
+        return capacity_class;
+    }
+
+    static size_type _ceil_class(size_type capacity)
+    {
+        size_type capacity_class = SILVA_SERIALIZER_BUFFER_POOL_MIN_CAPACITY_CLASS;
+        while (capacity_class < CAPACITY_CLASS_COUNT - 1 && (size_type(1) << capacity_class) < capacity)
+        {
+            capacity_class++;
+        }
+        return capacity_class;
+    }
+
+public:
+    /**
+     * @brief Construct a new buffer pool
+     * @param max_retained_bytes The maximum capacity (in bytes) that the pool keeps alive
+     */
+    buffer_pool(size_type max_retained_bytes = SILVA_SERIALIZER_BUFFER_POOL_DEFAULT_MAX_RETAINED_BYTES)
+        : m_buckets()
+        , m_max_retained_bytes(max_retained_bytes)
+        , m_mutex()
+        , m_hits(0)
+        , m_misses(0)
+        , m_releases(0)
+        , m_drops(0)
+    {}
+
+    virtual ~buffer_pool() override = default;
+
+    /**
+     * @brief Acquire an empty buffer able to hold at least min_capacity bytes without reallocating
+     * @param min_capacity The capacity required by the caller
+     * @retval byte_vector An empty buffer (to give back with release)
+     */
+    byte_vector acquire(size_type min_capacity = 0)
+    {
+        const size_type capacity_class = _ceil_class(min_capacity);
+
+        {
+            thread_safe::lock_guard lock(m_mutex);
+
+            for (size_type current_class = capacity_class; current_class < CAPACITY_CLASS_COUNT; current_class++)
+            {
+                std::vector<byte_vector>& bucket = m_buckets[current_class];
+
+                if (!bucket.empty())
+                {
+                    byte_vector buffer = std::move(bucket.back());
+                    bucket.pop_back();
+                    m_retained_bytes -= buffer.capacity();
+                    m_hits++;
+                    return buffer;
+                }
+            }
+        }
+
+        m_misses++;
+
+        byte_vector buffer;
+        buffer.reserve(size_type(1) << capacity_class);
+        return buffer;
+    }
+
+    /**
+     * @brief Give a buffer back to the pool
+     * @param buffer The buffer to recycle (its content is discarded)
+     */
+    void release(byte_vector buffer)
+    {
+        const size_type capacity = buffer.capacity();
+
+        // too small to ever be handed out again
+        if (capacity < (size_type(1) << SILVA_SERIALIZER_BUFFER_POOL_MIN_CAPACITY_CLASS))
+        {
+            return;
+        }
+
+        const size_type size = buffer.size();
+
+        buffer.clear();
+
+        thread_safe::lock_guard lock(m_mutex);
+
+        m_size_hint = size;
+
+        if (m_retained_bytes + capacity > m_max_retained_bytes)
+        {
+            m_drops++;
+            return; // buffer is freed when leaving the scope
+        }
+
+        m_retained_bytes += capacity;
+        m_buckets[_floor_class(capacity)].push_back(std::move(buffer));
+        m_releases++;
+    }
+
+    /**
+     * @brief Free every buffer currently retained by the pool (counters are kept)
+     */
+    void clear()
+    {
+        thread_safe::lock_guard lock(m_mutex);
+
+        for (std::vector<byte_vector>& bucket : m_buckets)
+        {
+            bucket.clear();
+        }
+        m_retained_bytes = 0;
+    }
+
+    /**
+     * @brief Size of the content of the last released buffer
+     * @details Messages of a stream tend to have similar sizes, acquiring that much up front
+     *          avoids growing the buffer again (and missing the buckets it was released to)
+     */
+    size_type size_hint() const
+    {
+        thread_safe::lock_guard lock(m_mutex);
+        return m_size_hint;
+    }
+
+    size_type max_retained_bytes() const
+    {
+        return m_max_retained_bytes;
+    }
+
+    statistics stats() const
+    {
+        thread_safe::lock_guard lock(m_mutex);
+
+        return statistics {
+            m_hits.load(),
+            m_misses.load(),
+            m_releases.load(),
+            m_drops.load(),
+            m_retained_bytes
+        };
+    }
+};
+
+}
+}
+}
+}
@@ -0,0 +1,76 @@
+/**
+ * hl/silva/collections/serialization/containers.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/serialization/serializer.hpp>
+#include <hl/silva/collections/serialization/deserializer.hpp>
+#include <hl/silva/collections/serialization/measure.hpp>
+
+#include <hl/silva/collections/thread_safe/vector.hpp>
+#include <hl/silva/collections/thread_safe/deque.hpp>
+#include <hl/silva/collections/thread_safe/list.hpp>
+
+// Serialization of the thread_safe containers
+// The container mutex is taken once for the whole operation and the content is encoded
+// with serializer::serialize_container (a single TYPED_ARRAY for arithmetic elements)
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace serialization
+{
+
+#define SILVA_SERIALIZATION_MAKE_THREAD_SAFE_CONTAINER_OPERATORS(CONTAINER) \
+    template<class T, class Allocator> \
+    inline serializer& operator<<(serializer& s, const thread_safe::CONTAINER<T, Allocator>& container) \
+    { \
+        const auto locked = container.locked_base(); \
+        return s.serialize_container(*locked); \
+    } \
+    template<class T, class Allocator> \
+    inline measure& operator<<(measure& m, const thread_safe::CONTAINER<T, Allocator>& container) \
+    { \
+        const auto locked = container.locked_base(); \
+        return m.serialize_container(*locked); \
+    } \
+    template<class T, class Allocator> \
+    inline deserializer& operator>>(deserializer& d, thread_safe::CONTAINER<T, Allocator>& container) \
+    { \
+        auto locked = container.locked_base(); \
+        return d.get_container_inplace(*locked); \
+    }
+
+SILVA_SERIALIZATION_MAKE_THREAD_SAFE_CONTAINER_OPERATORS(vector)
+SILVA_SERIALIZATION_MAKE_THREAD_SAFE_CONTAINER_OPERATORS(deque)
+SILVA_SERIALIZATION_MAKE_THREAD_SAFE_CONTAINER_OPERATORS(list)
+
+#undef SILVA_SERIALIZATION_MAKE_THREAD_SAFE_CONTAINER_OPERATORS
+
+}
+}
+}
+}
@@ -24,6 +24,11 @@
 #pragma once
 
 #include <hl/silva/collections/serialization/metadata.hpp>
+#include <hl/silva/collections/serialization/utf8.hpp>
+
+#ifndef SILVA_DESERIALIZER_DEFAULT_VALIDATE_UTF8
+#define SILVA_DESERIALIZER_DEFAULT_VALIDATE_UTF8 false
+#endif
 
 namespace hl
 {
@@ -40,6 +45,14 @@ private:
     byte_vector m_buffer;
 
     stdint::size_t m_index = 0;
+    stdint::size_t m_begin = 0; // offset of the first value (after the header)
+
+    serialization::metadata::archive_format m_format;
+    bool m_swap = false; // m_format.needs_swap() cached for the hot path
+    bool m_validate_utf8 = SILVA_DESERIALIZER_DEFAULT_VALIDATE_UTF8;
+
+    // offsets right after the records entered with begin_record() (innermost last)
+    std::vector<stdint::size_t> m_records;
 
 public:
     deserializer() = default;
@@ -48,21 +61,68 @@ public:
     deserializer(const byte_vector& buffer,
                 byte_vector& rest_buffer,
                 const serialization::metadata::magic_number &expected_magic=serialization::metadata::magic_number())
-        : m_buffer(buffer)
+    {
+        reset(buffer, rest_buffer, expected_magic);
+    }
+
+    deserializer(byte_vector&& buffer,
+                byte_vector& rest_buffer,
+                const serialization::metadata::magic_number &expected_magic=serialization::metadata::magic_number())
+    {
+        reset(std::move(buffer), rest_buffer, expected_magic);
+    }
+
+    /**
+     * @brief Start deserializing a new archive, reusing the memory of the previous one
+     * @param buffer The archive, copied into the storage already owned by the deserializer
+     * @param rest_buffer Receives the bytes following the archive (its capacity is reused too)
+     * @param expected_magic The magic number the archive must have
+     * @details The UTF-8 validation setting is kept
+     */
+    void reset(const byte_vector& buffer,
+                byte_vector& rest_buffer,
+                const serialization::metadata::magic_number &expected_magic=serialization::metadata::magic_number())
+    {
+        m_buffer.assign(buffer.begin(), buffer.end());
+        _load(rest_buffer, expected_magic);
+    }
+
+    /**
+     * @brief Start deserializing a new archive, taking ownership of its buffer
+     */
+    void reset(byte_vector&& buffer,
+                byte_vector& rest_buffer,
+                const serialization::metadata::magic_number &expected_magic=serialization::metadata::magic_number())
+    {
+        m_buffer = std::move(buffer);
+        _load(rest_buffer, expected_magic);
+    }
+
+    deserializer(const deserializer& other) = default;
+    deserializer(deserializer&& other) = default;
+    deserializer& operator=(const deserializer& other) = default;
+    deserializer& operator=(deserializer&& other) = default;
+
+private:
+    // parses the header of m_buffer and moves the bytes following the archive to rest_buffer
+    void _load(byte_vector& rest_buffer, const serialization::metadata::magic_number &expected_magic)
     {
         serialization::metadata::header_size_type size;
-        serialization::metadata::magic_number magic;
 
-        serialization::metadata::load_header(buffer, magic, size);
+        m_records.clear();
+
+        // FULL and COMPACT headers are told apart from their first byte
+        m_begin = serialization::metadata::decode_header(m_buffer.data(), m_buffer.size(), expected_magic, size, m_format);
 
-        if (magic.v32 != expected_magic.v32)
+        if (m_begin == 0)
         {
-            throw error("Magic number does not match the expected magic number");
+            throw error("Buffer is too small to load the header size it cannot possibly contain it");
         }
 
-        m_index = serialization::metadata::HEADER_SIZE;
+        m_swap = m_format.needs_swap();
+        m_index = m_begin;
 
-        if (m_index + size > m_buffer.size())
+        if (size < sizeof(serialization::metadata::type_chart) || size > m_buffer.size() - m_index)
         {
             throw error("Buffer is too small to contain the data");
         }
@@ -75,40 +135,77 @@ public:
         // Extract the rest of the buffer that will be not used by the deserializer
         if (m_index + size < m_buffer.size())
         {
-            rest_buffer = byte_vector(m_buffer.begin() + m_index + size, m_buffer.end());
+            rest_buffer.assign(m_buffer.begin() + m_index + size, m_buffer.end());
             // drop the end of the buffer that we stored in rest_buffer
             m_buffer.erase(m_buffer.begin() + m_index + size, m_buffer.end());
         }
         else
         {
-            rest_buffer = byte_vector();
+            rest_buffer.clear();
         }
     }
 
-    deserializer(const deserializer& other) = default;
-    deserializer(deserializer&& other) = default;
-    deserializer& operator=(const deserializer& other) = default;
-    deserializer& operator=(deserializer&& other) = default;
 
-private:
-    template<typename T, serialization::metadata::type_chart CType>
-    deserializer& _deserialize_inplace_arithmetic(T& value)
+    // end of the values that can be read: the end of the innermost record entered, or of the buffer
+    size_t _limit() const
+    {
+        return m_records.empty() ? m_buffer.size() : m_records.back();
+    }
+
+    [[noreturn]] void _throw_out_of_room() const
+    {
+        throw error(m_records.empty() ? "Buffer is too small to contain the value" : "Value goes past the end of the record");
+    }
+
+    // throws when size bytes at offset do not fit before limit
+    void _check_room(size_t offset, size_t size, size_t limit) const
     {
-        static const size_t MINIMUM_SIZE = sizeof(serialization::metadata::type_chart) + sizeof(T);
+        if (offset > limit || size > limit - offset)
+        {
+            _throw_out_of_room();
+        }
+    }
 
-        if (m_index + MINIMUM_SIZE > m_buffer.size())
+    // PADDING bytes are only inserted in ALIGNED archives (by archive::concatenate / archive::slice)
+    void _skip_padding()
+    {
+        if (m_format.is_aligned())
         {
-            throw error("Buffer is too small to contain the value");
+            const size_t limit = _limit();
+
+            while (m_index < limit && m_buffer[m_index] == serialization::metadata::type_chart::PADDING)
+            {
+                m_index++;
+            }
         }
-        else if (m_buffer[m_index] != CType)
+    }
+
+    template<typename T, serialization::metadata::type_chart CType>
+    deserializer& _deserialize_inplace_arithmetic(T& value)
+    {
+        _skip_padding();
+
+        const size_t limit = _limit();
+
+        _check_room(m_index, sizeof(serialization::metadata::type_chart), limit);
+        if (m_buffer[m_index] != CType)
         {
             throw error("Type does not match the expected type");
         }
 
-        value = *reinterpret_cast<T*>(&m_buffer[m_index + sizeof(serialization::metadata::type_chart)]);
-        m_index += sizeof(serialization::metadata::type_chart) + sizeof(T);
+        const size_t offset = m_format.payload_offset(m_index + sizeof(serialization::metadata::type_chart), sizeof(T));
+
+        _check_room(offset, sizeof(T), limit);
 
-        bit::network_to_native_inplace(value);
+        // memcpy instead of dereferencing a casted pointer: no alignment or aliasing UB,
+        // compilers emit a single (aligned with the ALIGNED layout) load anyway
+        std::memcpy(&value, &m_buffer[offset], sizeof(T));
+        m_index = offset + sizeof(T);
+
+        if (m_swap)
+        {
+            value = bit::swap_endian(value);
+        }
 
         return *this;
     }
@@ -116,34 +213,171 @@ private:
     template<typename T, serialization::metadata::type_chart CType>
     deserializer& _deserialize_inplace_array(T& value)
     {
-        static const size_t MINIMUM_SIZE = sizeof(serialization::metadata::type_chart) + sizeof(serialization::metadata::type_chart);
+        _skip_padding();
 
-        if (m_index + MINIMUM_SIZE > m_buffer.size())
+        const size_t limit = _limit();
+
+        _check_room(m_index, sizeof(serialization::metadata::type_chart), limit);
+        if (m_buffer[m_index] != CType)
         {
-            throw error("Buffer is too small to contain the value");
+            throw error("Type does not match the expected type");
         }
-        else if (m_buffer[m_index] != CType)
+
+        const size_t offset = m_format.payload_offset(m_index + sizeof(serialization::metadata::type_chart), sizeof(serialization::metadata::size_type));
+
+        _check_room(offset, sizeof(serialization::metadata::size_type), limit);
+
+        serialization::metadata::size_type size;
+        std::memcpy(&size, &m_buffer[offset], sizeof(serialization::metadata::size_type));
+
+        if (m_swap)
+        {
+            size = bit::swap_endian(size);
+        }
+
+        const size_t data_offset = offset + sizeof(serialization::metadata::size_type);
+
+        _check_room(data_offset, size, limit);
+
+        // validated in place in the archive buffer, no extra pass over the decoded string
+        HL_IF_CONSTEXPR (CType == serialization::metadata::type_chart::STRING)
+        {
+            if (m_validate_utf8 && !serialization::utf8::validate(m_buffer.data() + data_offset, size))
+            {
+                throw invalid_utf8_error("String is not valid UTF-8", m_index);
+            }
+        }
+
+        // assign keeps the storage of value when it is big enough
+        // (std::string::assign from iterators goes through a temporary string, the pointer overload does not)
+        HL_IF_CONSTEXPR (std::is_same<T, std::string>::value)
+        {
+            value.assign((const char*)m_buffer.data() + data_offset, size);
+        }
+        else
+        {
+            value.assign(m_buffer.begin() + data_offset, m_buffer.begin() + data_offset + size);
+        }
+        m_index = data_offset + size;
+
+        return *this;
+    }
+
+    // reads a TYPED_ARRAY header, returns the offset of the payload and moves m_index after it
+    size_t _deserialize_typed_array_header(serialization::metadata::type_chart& element_type, serialization::metadata::size_type& count)
+    {
+        static const size_t MINIMUM_SIZE = sizeof(serialization::metadata::type_chart) * 2;
+
+        _skip_padding();
+
+        const size_t limit = _limit();
+
+        _check_room(m_index, MINIMUM_SIZE, limit);
+        if (m_buffer[m_index] != serialization::metadata::type_chart::TYPED_ARRAY)
         {
             throw error("Type does not match the expected type");
         }
 
-        serialization::metadata::size_type size = *reinterpret_cast<serialization::metadata::size_type*>(&m_buffer[m_index + sizeof(serialization::metadata::type_chart)]);
-        bit::network_to_native_inplace(size);
+        element_type = (serialization::metadata::type_chart)m_buffer[m_index + sizeof(serialization::metadata::type_chart)];
+
+        const size_t element_size = serialization::metadata::type_chart_size(element_type);
+        const size_t offset = m_format.payload_offset(m_index + MINIMUM_SIZE, sizeof(serialization::metadata::size_type));
+
+        if (element_size == 0)
+        {
+            throw error("Invalid typed array element type");
+        }
+        _check_room(offset, sizeof(serialization::metadata::size_type), limit);
+
+        std::memcpy(&count, &m_buffer[offset], sizeof(serialization::metadata::size_type));
+
+        if (m_swap)
+        {
+            count = bit::swap_endian(count);
+        }
+
+        const size_t data_offset = offset + sizeof(serialization::metadata::size_type);
 
-        if (m_index + size + MINIMUM_SIZE > m_buffer.size())
+        if (count > (limit - data_offset) / element_size)
         {
-            throw error("Buffer is too small to contain the value");
+            _throw_out_of_room();
         }
 
-        m_index += MINIMUM_SIZE;
+        m_index = data_offset + count * element_size;
+        return data_offset;
+    }
+
+    deserializer& _deserialize_inplace_typed_array_value(serialization::metadata::typed_array& value)
+    {
+        serialization::metadata::type_chart element_type;
+        serialization::metadata::size_type count;
 
+        const size_t offset = _deserialize_typed_array_header(element_type, count);
+        const size_t element_size = serialization::metadata::type_chart_size(element_type);
 
-        value = T(m_buffer.begin() + m_index, m_buffer.begin() + m_index + size);
-        m_index += size;
+        value.element_type = element_type;
+        value.data.resize(count * element_size);
+        serialization::metadata::copy_elements(value.data.data(), &m_buffer[offset], count, element_size, m_swap);
 
         return *this;
     }
 
+    // reads a RECORD header, moves m_index to its first field and returns the offset right after the record
+    size_t _deserialize_record_header()
+    {
+        _skip_padding();
+
+        const size_t limit = _limit();
+
+        _check_room(m_index, sizeof(serialization::metadata::type_chart), limit);
+        if (m_buffer[m_index] != serialization::metadata::type_chart::RECORD)
+        {
+            throw error("Type does not match the expected type");
+        }
+
+        const size_t offset = m_format.payload_offset(m_index + sizeof(serialization::metadata::type_chart), sizeof(serialization::metadata::size_type));
+
+        _check_room(offset, sizeof(serialization::metadata::size_type), limit);
+
+        serialization::metadata::size_type length;
+        std::memcpy(&length, &m_buffer[offset], sizeof(serialization::metadata::size_type));
+
+        if (m_swap)
+        {
+            length = bit::swap_endian(length);
+        }
+
+        const size_t fields_offset = offset + sizeof(serialization::metadata::size_type);
+
+        // a nested record cannot go past the end of the record containing it
+        if (length > limit - fields_offset)
+        {
+            throw error("Record is bigger than its container");
+        }
+
+        m_index = fields_offset;
+        return fields_offset + length;
+    }
+
+    deserializer& _deserialize_inplace_record_value(serialization::metadata::record& value)
+    {
+        begin_record();
+        const size_t end = m_records.back();
+
+        value.fields.clear();
+        while (m_index < end)
+        {
+            value.fields.push_back(get_type_value());
+
+            if (m_index > end)
+            {
+                throw error("Record field goes past the end of the record");
+            }
+        }
+
+        return end_record();
+    }
+
 public:
 #define SILVA_DESERIALIZER_OPERATOR_NAMED(CTYPE, METADATA_TYPE, MEMBER_FUNC_NAME, METHOD_TYPE) \
     CTYPE get_##MEMBER_FUNC_NAME() { CTYPE value; _deserialize_inplace_##METHOD_TYPE<CTYPE, serialization::metadata::type_chart::METADATA_TYPE>(value); return value; } \
@@ -172,16 +406,30 @@ public:
     SILVA_DESERIALIZER_OPERATOR_NAMED(std::string, STRING,      string,     array);
     SILVA_DESERIALIZER_OPERATOR_NAMED(byte_vector, BYTE_ARRAY,  byte_array, array);
 
+    serialization::metadata::typed_array get_typed_array() { serialization::metadata::typed_array value; _deserialize_inplace_typed_array_value(value); return value; }
+    deserializer& operator>>(serialization::metadata::typed_array& value) { return _deserialize_inplace_typed_array_value(value); }
+    deserializer& get_typed_array_inplace(serialization::metadata::typed_array& value) { return *this >> value; }
+
+    serialization::metadata::record get_record() { serialization::metadata::record value; _deserialize_inplace_record_value(value); return value; }
+    deserializer& operator>>(serialization::metadata::record& value) { return _deserialize_inplace_record_value(value); }
+    deserializer& get_record_inplace(serialization::metadata::record& value) { return *this >> value; }
+
 #undef SILVA_DESERIALIZER_OPERATOR_NAMED
 #undef SILVA_DESERIALIZER_OPERATOR_CTYPE_ARITHMETIC
 #undef SILVA_DESERIALIZER_OPERATOR_CTYPE_UNIMPLEMENTED
 
     deserializer& operator>>(serialization::metadata::type_value& value)
     {
-        if (m_index + sizeof(serialization::metadata::type_chart) > m_buffer.size())
+        _skip_padding();
+
+        // the fields of a record end without END marker
+        if (!m_records.empty() && m_index == m_records.back())
         {
-            throw error("Buffer is too small to contain the value");
+            value = nullptr;
+            return *this;
         }
+
+        _check_room(m_index, sizeof(serialization::metadata::type_chart), _limit());
         switch ((serialization::metadata::type_chart)m_buffer[m_index])
         {
             #define SILVA_DESERIALIZER_SWITCH_CASE_TYPE_VALUE(TYPE, CTYPE) \
@@ -203,6 +451,8 @@ public:
             SILVA_DESERIALIZER_SWITCH_CASE_TYPE_VALUE(BOOL8, bool8);
             SILVA_DESERIALIZER_SWITCH_CASE_TYPE_VALUE(STRING, string);
             SILVA_DESERIALIZER_SWITCH_CASE_TYPE_VALUE(BYTE_ARRAY, byte_array);
+            SILVA_DESERIALIZER_SWITCH_CASE_TYPE_VALUE(TYPED_ARRAY, typed_array);
+            SILVA_DESERIALIZER_SWITCH_CASE_TYPE_VALUE(RECORD, record);
 
             #undef SILVA_DESERIALIZER_SWITCH_CASE_TYPE_VALUE
 
@@ -218,6 +468,75 @@ public:
         return *this;
     }
 
+    /**
+     * @brief Bulk decode a TYPED_ARRAY into a container of arithmetic values (its previous content is replaced)
+     * @details std::vector in the host byte order is filled with a single memcpy
+     * @tparam Container A container of is_typed_array_element values (std::vector, std::deque, std::list, ...)
+     */
+    template<class Container>
+    deserializer& get_typed_array_inplace(Container& container)
+    {
+        using T = typename Container::value_type;
+        static_assert(serialization::metadata::is_typed_array_element<T>::value, "Only integral types and bool8 can be decoded from a typed array");
+
+        serialization::metadata::type_chart element_type;
+        serialization::metadata::size_type count;
+        const stdint::size_t index = m_index;
+
+        const size_t offset = _deserialize_typed_array_header(element_type, count);
+
+        if (element_type != serialization::metadata::type_chart_of<T>())
+        {
+            m_index = index;
+            throw error("Typed array element type does not match the expected type");
+        }
+
+        const stdint::byte* in = &m_buffer[offset];
+
+        HL_IF_CONSTEXPR (std::is_same<Container, std::vector<T, typename Container::allocator_type>>::value && !std::is_same<T, bool>::value)
+        {
+            container.resize(count);
+            serialization::metadata::copy_elements((stdint::byte*)container.data(), in, count, sizeof(T), m_swap);
+            return *this;
+        }
+
+        container.clear();
+        for (serialization::metadata::size_type i = 0; i < count; i++, in += sizeof(T))
+        {
+            T value;
+            std::memcpy(&value, in, sizeof(T));
+            container.push_back(m_swap ? bit::swap_endian(value) : value);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Decode a container written by serializer::serialize_container (its previous content is replaced)
+     */
+    template<class Container>
+    deserializer& get_container_inplace(Container& container)
+    {
+        using T = typename Container::value_type;
+
+        HL_IF_CONSTEXPR (serialization::metadata::is_typed_array_element<T>::value)
+        {
+            return get_typed_array_inplace(container);
+        }
+        else
+        {
+            const stdint::u64 count = get_u64();
+
+            container.clear();
+            for (stdint::u64 i = 0; i < count; i++)
+            {
+                T value;
+                *this >> value;
+                container.push_back(std::move(value));
+            }
+            return *this;
+        }
+    }
+
     serialization::metadata::type_value get_type_value()
     {
         serialization::metadata::type_value value;
@@ -225,6 +544,69 @@ public:
         return value;
     }
 
+    /**
+     * @brief Enter the RECORD at the current position, the next values read are its fields
+     * @details Reading a type_value at the end of the fields gives nullptr (as for the END marker)
+     */
+    deserializer& begin_record()
+    {
+        const size_t end = _deserialize_record_header();
+        m_records.push_back(end);
+        return *this;
+    }
+
+    /**
+     * @brief Leave the innermost record entered with begin_record(), its unread fields are skipped in O(1)
+     */
+    deserializer& end_record()
+    {
+        if (m_records.empty())
+        {
+            throw error("No record to end");
+        }
+        else if (m_index > m_records.back())
+        {
+            throw error("Values were read past the end of the record");
+        }
+
+        m_index = m_records.back();
+        m_records.pop_back();
+        return *this;
+    }
+
+    /**
+     * @brief Move over the next value without decoding it (a whole RECORD is skipped in O(1))
+     */
+    deserializer& skip()
+    {
+        if (!m_records.empty() && m_index == m_records.back())
+        {
+            throw error("No value left in the record");
+        }
+
+        m_index = serialization::metadata::field_end(m_buffer, m_index, _limit(), m_format);
+        return *this;
+    }
+
+    /**
+     * @brief Enable or disable the UTF-8 validation of STRING values
+     * @details When enabled an invalid string throws invalid_utf8_error (the deserializer does not move)
+     */
+    void set_utf8_validation(bool enabled)
+    {
+        m_validate_utf8 = enabled;
+    }
+
+    bool utf8_validation() const
+    {
+        return m_validate_utf8;
+    }
+
+    const serialization::metadata::archive_format& get_format() const
+    {
+        return m_format;
+    }
+
     const byte_vector& get_buffer() const
     {
         return m_buffer;
@@ -240,6 +622,14 @@ public:
         return m_index;
     }
 
+    /**
+     * @brief Offset of the first value of the archive (the length of its header)
+     */
+    stdint::size_t body_offset() const
+    {
+        return m_begin;
+    }
+
     void seek(const stdint::size_t &index)
     {
         if (index >= m_buffer.size())
@@ -267,7 +657,7 @@ public:
             , _original_index(deserializer.get_index())
         {
             if (_index == 0) {
-                _index = serialization::metadata::HEADER_SIZE;
+                _index = deserializer.body_offset();
             }
         }
 
@@ -0,0 +1,227 @@
+/**
+ * hl/silva/collections/serialization/measure.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/serialization/metadata.hpp>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace serialization
+{
+
+/**
+ * @brief measure A sink that accepts the same operator<< chain as the serializer but only counts bytes
+ * @details serialized_size() is the exact length of the buffer that serializer::serialized_buffer()
+ *          would return for the same chain of values, without materializing any of it.
+ */
+class measure
+{
+public:
+    using size_type = serialization::metadata::size_type;
+
+private:
+    size_type m_size = 0; // size of the body (without header and END marker)
+    serialization::metadata::archive_format m_format;
+
+    // same as serializer::_pad_payload the offset is counted from the first byte of the archive
+    void _measure_chart_and_payload(const size_type& alignment, const size_type& payload_size)
+    {
+        const size_type offset = serialization::metadata::HEADER_SIZE + m_size + serialization::metadata::TYPE_CHART_SIZE;
+        m_size = m_format.payload_offset(offset, alignment) - serialization::metadata::HEADER_SIZE + payload_size;
+    }
+
+    template<class T>
+    measure& _measure_arithmetic_inplace(const T&)
+    {
+        _measure_chart_and_payload(sizeof(T), sizeof(T));
+        return *this;
+    }
+
+    template<class T>
+    measure& _measure_array_inplace(const T& value)
+    {
+        _measure_chart_and_payload(sizeof(size_type), serialization::metadata::SIZE_TYPE_SIZE + value.size());
+        return *this;
+    }
+
+    void _measure_typed_array(const size_type& payload_size)
+    {
+        m_size += serialization::metadata::TYPE_CHART_SIZE; // element type
+        _measure_chart_and_payload(sizeof(size_type), serialization::metadata::SIZE_TYPE_SIZE + payload_size);
+    }
+
+public:
+    measure() = default;
+    ~measure() = default;
+
+    /**
+     * @brief Construct a measure for archives of the given format (the layout changes the padding)
+     */
+    measure(const serialization::metadata::archive_format& format)
+        : m_format(format)
+    {}
+
+    measure(const measure& other) = default;
+    measure(measure&& other) = default;
+    measure& operator=(const measure& other) = default;
+    measure& operator=(measure&& other) = default;
+
+#define SILVA_MEASURE_MAKE_OPERATOR_MANUAL(CTYPE, FUNC_NAME, OPERATION_TYPE) \
+    measure& operator<<(const CTYPE& value) { return _measure_##OPERATION_TYPE##_inplace<CTYPE>(value); } \
+    measure& measure_##FUNC_NAME(const CTYPE& value) { return *this << value; } \
+
+#define SILVA_MEASURE_MAKE_OPERATOR_MANUAL_WITH_OP(CTYPE, FUNC_NAME, OPERATION) \
+    measure& operator<<(const CTYPE& value) { { OPERATION; } return *this; } \
+    measure& measure_##FUNC_NAME(const CTYPE& value) { return *this << value; } \
+
+#define SILVA_MEASURE_MAKE_OPERATOR_UNIMPLEMENTED(CTYPE, FUNC_NAME) \
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL_WITH_OP(CTYPE, FUNC_NAME, (void)value; throw error("Not implemented for " #CTYPE))
+
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::u8,     u8,     arithmetic);
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::u16,    u16,    arithmetic);
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::u32,    u32,    arithmetic);
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::u64,    u64,    arithmetic);
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::i8,     i8,     arithmetic);
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::i16,    i16,    arithmetic);
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::i32,    i32,    arithmetic);
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::i64,    i64,    arithmetic);
+
+    SILVA_MEASURE_MAKE_OPERATOR_UNIMPLEMENTED(stdint::f32, f32);
+    SILVA_MEASURE_MAKE_OPERATOR_UNIMPLEMENTED(stdint::f64, f64);
+
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(stdint::bool8, bool8, arithmetic);
+
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(std::string,    string,     array);
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL(byte_vector,    byte_array, array);
+
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL_WITH_OP(serialization::metadata::typed_array, typed_array, _measure_typed_array(value.data.size()));
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL_WITH_OP(serialization::metadata::record, record, begin_record(); for (const auto& field : value.fields) { *this << field; } end_record());
+
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL_WITH_OP(char *, cstring, _measure_chart_and_payload(sizeof(size_type), serialization::metadata::SIZE_TYPE_SIZE + std::char_traits<char>::length(value)));
+    SILVA_MEASURE_MAKE_OPERATOR_MANUAL_WITH_OP(serialization::metadata::type_value, type_value, std::visit([&](auto&& arg) { *this << arg; }, value));
+
+#undef SILVA_MEASURE_MAKE_OPERATOR_MANUAL
+#undef SILVA_MEASURE_MAKE_OPERATOR_MANUAL_WITH_OP
+#undef SILVA_MEASURE_MAKE_OPERATOR_UNIMPLEMENTED
+
+    // a nullptr type_value stands for the END marker which is only written by serialized_buffer()
+    measure& operator<<(const nullptr_t&)
+    {
+        return *this;
+    }
+
+    measure& begin_record()
+    {
+        _measure_chart_and_payload(sizeof(size_type), serialization::metadata::SIZE_TYPE_SIZE);
+        return *this;
+    }
+
+    // the byte length is counted by begin_record()
+    measure& end_record()
+    {
+        return *this;
+    }
+
+    template<class Container>
+    measure& serialize_typed_array(const Container& container)
+    {
+        _measure_typed_array(container.size() * sizeof(typename Container::value_type));
+        return *this;
+    }
+
+    template<class Container>
+    measure& serialize_container(const Container& container)
+    {
+        using T = typename Container::value_type;
+
+        HL_IF_CONSTEXPR (serialization::metadata::is_typed_array_element<T>::value)
+        {
+            return serialize_typed_array(container);
+        }
+        else
+        {
+            *this << stdint::u64(container.size());
+            for (const T& value : container)
+            {
+                *this << value;
+            }
+            return *this;
+        }
+    }
+
+    template<typename T>
+    measure& serialize(const T& value)
+    {
+        return *this << value;
+    }
+
+    /**
+     * @brief Size of the serialized values only (what serializer::get_raw_buffer().size() would be)
+     */
+    size_type body_size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * @brief Exact size of the buffer returned by serializer::serialized_buffer() (header, values and END marker)
+     */
+    size_type serialized_size() const
+    {
+        const size_type size = m_size + serialization::metadata::TYPE_CHART_SIZE;
+        return serialization::metadata::header_size(m_format, size) + size;
+    }
+
+    void clear()
+    {
+        m_size = 0;
+    }
+};
+
+/**
+ * @brief Compile time serialized size of a schema made only of fixed size (arithmetic) fields
+ * @note Only valid for the PACKED layout with a FULL header, use measure for other formats
+ * @tparam Ts The types of the fields in serialization order
+ * @retval The exact size of serializer::serialized_buffer() for those fields
+ */
+template<typename... Ts>
+HL_CONSTEXPR_FUNCTION serialization::metadata::size_type fixed_serialized_size()
+{
+    // std::is_arithmetic would also accept char, long long or double that the serializer cannot encode
+    static_assert((serialization::metadata::is_typed_array_element<Ts>::value && ...),
+        "fixed_serialized_size only supports the arithmetic fields of the serializer (u8 to i64 and bool8)");
+
+    return serialization::metadata::HEADER_SIZE
+        + ((serialization::metadata::TYPE_CHART_SIZE + sizeof(Ts)) + ... + 0)
+        + serialization::metadata::TYPE_CHART_SIZE;
+}
+
+}
+}
+}
+}
@@ -35,7 +35,48 @@ namespace serialization
 {
 namespace metadata 
 {
-    using type_value = std::variant<stdint::u8, stdint::u16, stdint::u32, stdint::u64, stdint::i8, stdint::i16, stdint::i32, stdint::i64, stdint::f32, stdint::f64, stdint::bool8, std::string, byte_vector, nullptr_t>;
+    /**
+     * @brief typed_array The decoded form of a TYPED_ARRAY value
+     */
+    struct typed_array
+    {
+        stdint::u8 element_type;    // the type_chart of the elements
+        byte_vector data;           // the elements in native byte order
+
+        bool operator==(const typed_array& other) const
+        {
+            return element_type == other.element_type && data == other.data;
+        }
+
+        bool operator!=(const typed_array& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    struct record;
+
+    using type_value = std::variant<stdint::u8, stdint::u16, stdint::u32, stdint::u64, stdint::i8, stdint::i16, stdint::i32, stdint::i64, stdint::f32, stdint::f64, stdint::bool8, std::string, byte_vector, typed_array, record, nullptr_t>;
+
+    /**
+     * @brief record The decoded form of a RECORD value: the fields nested in it
+     * @details A RECORD is encoded like a byte array, [RECORD][byte length][fields] (without END marker),
+     *          so a reader can jump over it without decoding its fields
+     */
+    struct record
+    {
+        std::vector<type_value> fields;
+
+        bool operator==(const record& other) const
+        {
+            return fields == other.fields;
+        }
+
+        bool operator!=(const record& other) const
+        {
+            return !(*this == other);
+        }
+    };
 
     enum type_chart : stdint::u8
     {
@@ -53,10 +94,71 @@ namespace metadata
         BOOL8       = meta::variant_index<type_value, stdint::bool8>(),
         STRING      = meta::variant_index<type_value, std::string>(),
         BYTE_ARRAY  = meta::variant_index<type_value, byte_vector>(),
+        TYPED_ARRAY = meta::variant_index<type_value, typed_array>(),
+        RECORD      = meta::variant_index<type_value, record>(),
 
+        PADDING     = 0xFE, // single byte without payload skipped by readers (used to realign ALIGNED values)
         END         = 0xFF
     };
 
+    /**
+     * @brief Types that can be bulk encoded as elements of a TYPED_ARRAY
+     * @details The same list as the arithmetic operator<< of the serializer (floating point values are not serializable yet)
+     */
+    template<typename T>
+    struct is_typed_array_element : std::integral_constant<bool,
+        std::is_same<T, stdint::u8>::value  || std::is_same<T, stdint::u16>::value ||
+        std::is_same<T, stdint::u32>::value || std::is_same<T, stdint::u64>::value ||
+        std::is_same<T, stdint::i8>::value  || std::is_same<T, stdint::i16>::value ||
+        std::is_same<T, stdint::i32>::value || std::is_same<T, stdint::i64>::value ||
+        std::is_same<T, stdint::bool8>::value>
+    {};
+
+    template<typename T>
+    HL_CONSTEVAL type_chart type_chart_of()
+    {
+        return (type_chart)meta::variant_index<type_value, T>();
+    }
+
+    /**
+     * @brief Size of the payload of a fixed size type chart (0 for variable size ones)
+     */
+    static inline stdint::size_t type_chart_size(const type_chart& type)
+    {
+        switch (type)
+        {
+            case U8:    return sizeof(stdint::u8);
+            case U16:   return sizeof(stdint::u16);
+            case U32:   return sizeof(stdint::u32);
+            case U64:   return sizeof(stdint::u64);
+            case I8:    return sizeof(stdint::i8);
+            case I16:   return sizeof(stdint::i16);
+            case I32:   return sizeof(stdint::i32);
+            case I64:   return sizeof(stdint::i64);
+            case F32:   return sizeof(stdint::f32);
+            case F64:   return sizeof(stdint::f64);
+            case BOOL8: return sizeof(stdint::bool8);
+            default:    return 0;
+        }
+    }
+
+    /**
+     * @brief Copy count elements of element_size bytes, byte swapping each of them if swap is set
+     */
+    static inline void copy_elements(stdint::byte* out, const stdint::byte* in, stdint::size_t count, stdint::size_t element_size, bool swap)
+    {
+        if (!swap || element_size == 1)
+        {
+            std::memcpy(out, in, count * element_size);
+            return;
+        }
+
+        for (stdint::size_t i = 0; i < count; i++, in += element_size, out += element_size)
+        {
+            std::reverse_copy(in, in + element_size, out);
+        }
+    }
+
     static inline std::string to_string(const type_chart &type)
     {
         switch (type)
@@ -75,6 +177,9 @@ namespace metadata
             case BOOL8:         return "BOOL8";
             case STRING:        return "STRING";
             case BYTE_ARRAY:    return "BYTE_ARRAY";
+            case TYPED_ARRAY:   return "TYPED_ARRAY";
+            case RECORD:        return "RECORD";
+            case PADDING:       return "PADDING";
             case END:           return "END(or nullptr)";
             default:            return "UNKNOWN";
         }
@@ -94,6 +199,19 @@ namespace metadata
             {
                 return "byte_vector<size=" + std::to_string(arg.size()) + ">";
             }
+            else HL_IF_CONSTEXPR(std::is_same_v<T, typed_array>)
+            {
+                return "typed_array<" + to_string((type_chart)arg.element_type) + ", size=" + std::to_string(arg.data.size()) + ">";
+            }
+            else HL_IF_CONSTEXPR(std::is_same_v<T, record>)
+            {
+                std::string result = "record<";
+                for (stdint::size_t i = 0; i < arg.fields.size(); i++)
+                {
+                    result += (i == 0 ? "" : ", ") + metadata::to_string(arg.fields[i]);
+                }
+                return result + ">";
+            }
             else HL_IF_CONSTEXPR(std::is_same_v<T, nullptr_t>)
             {
                 return "nullptr_t<end_marker>";
@@ -142,10 +260,240 @@ namespace metadata
 
     using header_byte_array = std::array<stdint::byte, HEADER_SIZE>;
 
-    static header_byte_array make_header(const magic_number& magic, const header_size_type& size)
+    // The most significant byte of the header size is reserved for flags describing the body
+    using header_flags = stdint::u8;
+
+    static const header_flags    HEADER_FLAG_NONE            = 0;
+    static const header_flags    HEADER_FLAG_LITTLE_ENDIAN   = 1 << 0; // body values are little endian instead of big endian
+    static const header_flags    HEADER_FLAG_ALIGNED         = 1 << 1; // body payloads are padded to their natural alignment
+    static const header_flags    HEADER_FLAG_KNOWN           = HEADER_FLAG_LITTLE_ENDIAN | HEADER_FLAG_ALIGNED;
+
+    static const size_type       HEADER_FLAGS_SHIFT          = (HEADER_SIZE_TYPE_SIZE - sizeof(header_flags)) * 8;
+    static const header_size_type HEADER_SIZE_MASK           = (header_size_type(1) << HEADER_FLAGS_SHIFT) - 1;
+
+    /**
+     * @brief field_layout Where the payload of a value starts relatively to its type chart
+     * @details PACKED: the payload directly follows the type chart
+     *          ALIGNED: zero bytes are inserted after the type chart so that the payload offset
+     *                   (counted from the first byte of the archive) is a multiple of its size
+     *                   (its natural alignment), for arrays the u64 size is aligned on 8 bytes.
+     *                   Decoding is then made of aligned loads as long as the archive buffer itself
+     *                   is aligned (which std::vector / new guarantee)
+     */
+    enum class field_layout : stdint::u8
+    {
+        PACKED,
+        ALIGNED
+    };
+
+    /**
+     * @brief header_kind How the archive header is encoded
+     * @details FULL: [magic number (4 bytes)][flags|size (8 bytes)], HEADER_SIZE bytes
+     *          COMPACT: [magic tag (1 byte)][varint(size << 1 | little endian flag)], 2 bytes for bodies up to 63 bytes,
+     *                   only for PACKED archives (the header length depends on the size of the body)
+     */
+    enum class header_kind : stdint::u8
     {
+        FULL,
+        COMPACT
+    };
+
+    /**
+     * @brief Offset of a payload of the given alignment that cannot start before offset
+     */
+    HL_CONSTEXPR_STATIC_INLINE_FUNCTION size_type align_offset(const size_type& offset, const size_type& alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    /**
+     * @brief archive_format How the values of an archive body are encoded
+     * @details The header itself is always in network byte order, the format is stored in its flags
+     */
+    struct archive_format
+    {
+        bit::endian byte_order = bit::endian::native;
+        field_layout layout = field_layout::PACKED;
+        header_kind header = header_kind::FULL;
+
+        archive_format() = default;
+
+        archive_format(const bit::endian& order, const field_layout& playout=field_layout::PACKED, const header_kind& pheader=header_kind::FULL)
+            : byte_order(order)
+            , layout(playout)
+            , header(pheader)
+        {
+            if (byte_order != bit::endian::big && byte_order != bit::endian::little)
+            {
+                throw error("Only big and little endian archives are supported");
+            }
+            _check_header();
+        }
+
+        archive_format(const field_layout& playout)
+            : layout(playout)
+        {}
+
+        archive_format(const header_kind& pheader)
+            : header(pheader)
+        {}
+
+        void _check_header() const
+        {
+            if (header == header_kind::COMPACT && layout == field_layout::ALIGNED)
+            {
+                throw error("Compact headers are only supported by PACKED archives");
+            }
+        }
+
+        header_flags flags() const
+        {
+            return (byte_order == bit::endian::little ? HEADER_FLAG_LITTLE_ENDIAN : HEADER_FLAG_NONE)
+                | (layout == field_layout::ALIGNED ? HEADER_FLAG_ALIGNED : HEADER_FLAG_NONE);
+        }
+
+        static archive_format from_flags(const header_flags& flags)
+        {
+            if (flags & ~HEADER_FLAG_KNOWN)
+            {
+                throw error("Archive uses unsupported header flags");
+            }
+
+            return archive_format(
+                (flags & HEADER_FLAG_LITTLE_ENDIAN) ? bit::endian::little : bit::endian::big,
+                (flags & HEADER_FLAG_ALIGNED) ? field_layout::ALIGNED : field_layout::PACKED);
+        }
+
+        // whether the values have to be byte swapped between the archive and this machine
+        bool needs_swap() const
+        {
+            return byte_order != bit::endian::native;
+        }
+
+        bool is_aligned() const
+        {
+            return layout == field_layout::ALIGNED;
+        }
+
+        bool is_compact() const
+        {
+            return header == header_kind::COMPACT;
+        }
+
+        bool operator==(const archive_format& other) const
+        {
+            return byte_order == other.byte_order && layout == other.layout && header == other.header;
+        }
+
+        bool operator!=(const archive_format& other) const
+        {
+            return !(*this == other);
+        }
+
+        /**
+         * @brief Offset of a payload of the given alignment placed right after a type chart ending at offset
+         */
+        size_type payload_offset(const size_type& offset, const size_type& alignment) const
+        {
+            return is_aligned() ? align_offset(offset, alignment) : offset;
+        }
+    };
+
+    /**
+     * @brief Offset right after the value starting at index, computed from its type chart without decoding it
+     * @details Returns end when only PADDING bytes are left
+     * @param buffer The archive (the offsets are counted from its first byte)
+     * @param index The offset of the type chart of the value
+     * @param end The offset after which nothing belongs to the archive
+     * @param format The format of the archive
+     */
+    static inline size_type field_end(const byte_vector& buffer, size_type index, const size_type& end, const archive_format& format)
+    {
+        // PADDING bytes belong to the value that follows them
+        while (index < end && buffer[index] == PADDING)
+        {
+            index++;
+        }
+
+        if (index == end)
+        {
+            return end;
+        }
+
+        const type_chart type = (type_chart)buffer[index];
+        size_type offset = index + TYPE_CHART_SIZE;
+        size_type element_size = 1;
+
+        switch (type)
+        {
+            case END:
+                return offset;
+
+            case STRING:
+            case BYTE_ARRAY:
+            case RECORD:
+                break;
+
+            case TYPED_ARRAY:
+                if (offset + TYPE_CHART_SIZE > end)
+                {
+                    throw error("Buffer is too small to contain the value");
+                }
+                element_size = type_chart_size((type_chart)buffer[offset]);
+                offset += TYPE_CHART_SIZE;
+                if (element_size == 0)
+                {
+                    throw error("Invalid typed array element type");
+                }
+                break;
+
+            default:
+            {
+                const size_type size = type_chart_size(type);
+
+                if (size == 0)
+                {
+                    throw error("Unknown type??");
+                }
+
+                offset = format.payload_offset(offset, size);
+                if (offset + size > end)
+                {
+                    throw error("Buffer is too small to contain the value");
+                }
+                return offset + size;
+            }
+        }
+
+        offset = format.payload_offset(offset, SIZE_TYPE_SIZE);
+
+        if (offset + SIZE_TYPE_SIZE > end)
+        {
+            throw error("Buffer is too small to contain the value");
+        }
+
+        size_type count;
+        std::memcpy(&count, &buffer[offset], SIZE_TYPE_SIZE);
+        count = bit::from_endian(count, format.byte_order);
+        offset += SIZE_TYPE_SIZE;
+
+        if (count > (end - offset) / element_size)
+        {
+            throw error("Buffer is too small to contain the value");
+        }
+
+        return offset + count * element_size;
+    }
+
+    static inline header_byte_array make_header(const magic_number& magic, const header_size_type& size, const header_flags& flags)
+    {
+        if (size > HEADER_SIZE_MASK)
+        {
+            throw error("Archive is too big to be described by the header");
+        }
+
         header_byte_array header;
-        header_size_type net_size = bit::native_to_network(size);
+        header_size_type net_size = bit::native_to_network(size | (header_size_type(flags) << HEADER_FLAGS_SHIFT));
         magic_number net_magic = bit::native_to_network(magic.v32);
 
         const stdint::byte* magic_ptr = (stdint::byte*)&net_magic.v8[0];
@@ -157,7 +505,12 @@ namespace metadata
         return header;
     }
 
-    static void load_header(const byte_vector& buffer, magic_number& magic, header_size_type& size)
+    static inline header_byte_array make_header(const magic_number& magic, const header_size_type& size)
+    {
+        return make_header(magic, size, HEADER_FLAG_NONE);
+    }
+
+    static inline void load_header(const byte_vector& buffer, magic_number& magic, header_size_type& size, header_flags& flags)
     {
         if (buffer.size() < HEADER_SIZE)
         {
@@ -165,10 +518,148 @@ namespace metadata
         }
 
         std::copy(buffer.begin(), buffer.begin() + MAGIC_NUMBER_SIZE, magic.v8);
-        size = *(const header_size_type*)&buffer[MAGIC_NUMBER_SIZE];
+        std::memcpy(&size, &buffer[MAGIC_NUMBER_SIZE], sizeof(header_size_type));
 
         bit::network_to_native_inplace(size);
         bit::network_to_native_inplace(magic.v32);
+
+        flags = header_flags(size >> HEADER_FLAGS_SHIFT);
+        size &= HEADER_SIZE_MASK;
+    }
+
+    static inline void load_header(const byte_vector& buffer, magic_number& magic, header_size_type& size)
+    {
+        header_flags flags;
+        load_header(buffer, magic, size, flags);
+    }
+
+    static const size_type       COMPACT_HEADER_MAX_SIZE     = 1 + (sizeof(header_size_type) * 8 + 6) / 7;
+
+    /**
+     * @brief The 1 byte tag starting a COMPACT header: the XOR of the magic number bytes,
+     *        never equal to the first byte of a FULL header so that both can be told apart
+     */
+    static inline stdint::byte compact_tag(const magic_number& magic)
+    {
+        const stdint::byte first = stdint::byte(magic.v32 >> 24);
+        const stdint::byte tag = first ^ stdint::byte(magic.v32 >> 16) ^ stdint::byte(magic.v32 >> 8) ^ stdint::byte(magic.v32);
+
+        return tag == first ? stdint::byte(tag ^ 0x80) : tag;
+    }
+
+    /**
+     * @brief Number of bytes of the header of an archive whose END terminated body is size bytes long
+     */
+    static inline size_type header_size(const archive_format& format, const header_size_type& size)
+    {
+        if (!format.is_compact())
+        {
+            return HEADER_SIZE;
+        }
+
+        header_size_type value = size << 1;
+        size_type length = 2;
+
+        while (value >>= 7)
+        {
+            length++;
+        }
+        return length;
+    }
+
+    /**
+     * @brief Encode the FULL or COMPACT header of an archive
+     * @retval The number of bytes written at the start of header
+     */
+    static inline size_type encode_header(header_byte_array& header, const magic_number& magic, const header_size_type& size, const archive_format& format)
+    {
+        if (!format.is_compact())
+        {
+            header = make_header(magic, size, format.flags());
+            return HEADER_SIZE;
+        }
+        else if (size > HEADER_SIZE_MASK)
+        {
+            throw error("Archive is too big to be described by the header");
+        }
+
+        header_size_type value = (size << 1) | (format.byte_order == bit::endian::little ? 1 : 0);
+        size_type length = 0;
+
+        header[length++] = compact_tag(magic);
+        while (value >= 0x80)
+        {
+            header[length++] = stdint::byte(value | 0x80);
+            value >>= 7;
+        }
+        header[length++] = stdint::byte(value);
+        return length;
+    }
+
+    /**
+     * @brief Decode the FULL or COMPACT header (told apart from its first byte) of an archive
+     * @param data The first bytes of the archive
+     * @param available The number of bytes at data
+     * @param expected_magic The magic number the archive must have
+     * @param size Receives the size of the body (END marker included)
+     * @param format Receives the format of the archive
+     * @retval The header length, 0 if the available bytes do not contain the whole header yet
+     */
+    static inline size_type decode_header(const stdint::byte* data, const size_type& available, const magic_number& expected_magic,
+        header_size_type& size, archive_format& format)
+    {
+        if (available == 0)
+        {
+            return 0;
+        }
+        else if (data[0] != compact_tag(expected_magic))
+        {
+            if (data[0] != stdint::byte(expected_magic.v32 >> 24))
+            {
+                throw error("Magic number does not match the expected magic number");
+            }
+            else if (available < HEADER_SIZE)
+            {
+                return 0;
+            }
+
+            magic_number magic;
+            header_size_type value;
+
+            std::memcpy(magic.v8, data, MAGIC_NUMBER_SIZE);
+            std::memcpy(&value, data + MAGIC_NUMBER_SIZE, sizeof(header_size_type));
+            bit::network_to_native_inplace(magic.v32);
+            bit::network_to_native_inplace(value);
+
+            if (magic.v32 != expected_magic.v32)
+            {
+                throw error("Magic number does not match the expected magic number");
+            }
+
+            format = archive_format::from_flags(header_flags(value >> HEADER_FLAGS_SHIFT));
+            size = value & HEADER_SIZE_MASK;
+            return HEADER_SIZE;
+        }
+
+        header_size_type value = 0;
+
+        for (size_type i = 1; i < COMPACT_HEADER_MAX_SIZE; i++)
+        {
+            if (i == available)
+            {
+                return 0;
+            }
+
+            value |= header_size_type(data[i] & 0x7F) << (7 * (i - 1));
+
+            if ((data[i] & 0x80) == 0)
+            {
+                format = archive_format(value & 1 ? bit::endian::little : bit::endian::big, field_layout::PACKED, header_kind::COMPACT);
+                size = value >> 1;
+                return i + 1;
+            }
+        }
+        throw error("Invalid compact header size");
     }
 }
 }
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <hl/silva/collections/serialization/metadata.hpp>
+#include <hl/silva/collections/serialization/buffer_pool.hpp>
 
 namespace hl
 {
@@ -39,6 +40,14 @@ class serializer
 private:
     byte_vector m_buffer;
     serialization::metadata::magic_number m_magic;
+    serialization::metadata::archive_format m_format;
+    bool m_swap = false; // m_format.needs_swap() cached for the hot path
+
+    // when set m_buffer and the serialized buffers are drawn from (and given back to) this pool
+    buffer_pool* m_pool = nullptr;
+
+    // offsets in m_buffer of the byte length of the records not ended yet (innermost last)
+    std::vector<stdint::size_t> m_records;
 
 public:
     serializer() = default;
@@ -48,20 +57,66 @@ public:
     serializer& operator=(const serializer& other) = default;
     serializer& operator=(serializer&& other) = default;
 
-    serializer(const serialization::metadata::magic_number& magic)
+    /**
+     * @brief Construct a serializer
+     * @param magic The magic number of the archive
+     * @param format The encoding of the values, native byte order by default so that
+     *               a reader with the same endianness never has to swap anything
+     */
+    serializer(const serialization::metadata::magic_number& magic,
+        const serialization::metadata::archive_format& format=serialization::metadata::archive_format())
         : m_buffer()
         , m_magic(magic)
-    {}
+        , m_format(format)
+        , m_swap(format.needs_swap())
+    {
+        m_format._check_header();
+    }
 
-    ~serializer() = default;
+    /**
+     * @brief Construct a serializer that recycles its buffers through a pool
+     * @param pool The pool to draw the buffers from, it must outlive the serializer
+     *             (the internal buffer is sized after pool.size_hint())
+     * @param magic The magic number of the archive
+     * @param format The encoding of the values
+     * @note The buffers returned by serialized_buffer() should be given back with pool.release()
+     *       once they are not needed anymore (typically when the send has completed)
+     */
+    serializer(buffer_pool& pool,
+        const serialization::metadata::magic_number& magic=serialization::metadata::magic_number(),
+        const serialization::metadata::archive_format& format=serialization::metadata::archive_format())
+        : m_buffer(pool.acquire(pool.size_hint()))
+        , m_magic(magic)
+        , m_format(format)
+        , m_swap(format.needs_swap())
+        , m_pool(&pool)
+    {
+        m_format._check_header();
+    }
+
+    ~serializer()
+    {
+        if (m_pool != nullptr)
+        {
+            m_pool->release(std::move(m_buffer));
+        }
+    }
 
 private:
+    // zero fill after a type chart so that the next payload starts at its alignment (ALIGNED layout only)
+    void _pad_payload(const serialization::metadata::size_type& alignment)
+    {
+        const serialization::metadata::size_type offset = serialization::metadata::HEADER_SIZE + m_buffer.size();
+        m_buffer.resize(m_buffer.size() + (m_format.payload_offset(offset, alignment) - offset), 0);
+    }
+
     template<class T, serialization::metadata::type_chart CType>
     serializer& _serialize_arithmetic_inplace(const T& value)
     {
         m_buffer.push_back(CType);
-        T big_value = bit::native_to_network(value);
-        m_buffer.insert(m_buffer.end(), (stdint::byte*)&big_value, (stdint::byte*)&big_value + sizeof(T));
+        _pad_payload(sizeof(T));
+        const T archive_value = m_swap ? bit::swap_endian(value) : value;
+        m_buffer.insert(m_buffer.end(), (stdint::byte*)&archive_value, (stdint::byte*)&archive_value + sizeof(T));
         return *this;
     }
 
@@ -69,13 +124,62 @@ private:
     serializer& _serialize_array_inplace(const T& value)
     {
         m_buffer.push_back(CType);
+        _pad_payload(sizeof(stdint::u64));
         stdint::u64 size = value.size();
-        stdint::u64 big_size = bit::native_to_network(size);
-        m_buffer.insert(m_buffer.end(), (stdint::byte*)&big_size, (stdint::byte*)&big_size + sizeof(stdint::u64));
+        const stdint::u64 archive_size = m_swap ? bit::swap_endian(size) : size;
+        m_buffer.insert(m_buffer.end(), (stdint::byte*)&archive_size, (stdint::byte*)&archive_size + sizeof(stdint::u64));
         m_buffer.insert(m_buffer.end(), value.begin(), value.end());
         return *this;
     }
 
+    // writes the TYPED_ARRAY header and returns the offset in m_buffer of the (reserved) count * element_size payload
+    stdint::size_t _begin_typed_array(const serialization::metadata::type_chart& element_type, const stdint::u64& count, const stdint::size_t& element_size)
+    {
+        m_buffer.push_back(serialization::metadata::type_chart::TYPED_ARRAY);
+        m_buffer.push_back(element_type);
+        _pad_payload(sizeof(stdint::u64));
+        const stdint::u64 archive_count = m_swap ? bit::swap_endian(count) : count;
+        m_buffer.insert(m_buffer.end(), (stdint::byte*)&archive_count, (stdint::byte*)&archive_count + sizeof(stdint::u64));
+
+        const stdint::size_t offset = m_buffer.size();
+        m_buffer.resize(offset + count * element_size);
+        return offset;
+    }
+
+    serializer& _serialize_typed_array_value(const serialization::metadata::typed_array& value)
+    {
+        const stdint::size_t element_size = serialization::metadata::type_chart_size((serialization::metadata::type_chart)value.element_type);
+
+        if (element_size == 0 || value.data.size() % element_size != 0)
+        {
+            throw error("Invalid typed array");
+        }
+
+        const stdint::u64 count = value.data.size() / element_size;
+        const stdint::size_t offset = _begin_typed_array((serialization::metadata::type_chart)value.element_type, count, element_size);
+
+        serialization::metadata::copy_elements(&m_buffer[offset], value.data.data(), count, element_size, m_swap);
+        return *this;
+    }
+
+    serializer& _serialize_record_value(const serialization::metadata::record& value)
+    {
+        begin_record();
+        for (const serialization::metadata::type_value& field : value.fields)
+        {
+            *this << field;
+        }
+        return end_record();
+    }
+
+    void _check_records_ended() const
+    {
+        if (!m_records.empty())
+        {
+            throw error("A record has not been ended");
+        }
+    }
+
 public:
 
 #define SILVA_SERIALIZER_MAKE_OPERATOR_MANUAL(CTYPE, FUNC_NAME, TYPE_CHART, OPERATION_TYPE) \
@@ -108,6 +212,9 @@ public:
     SILVA_SERIALIZER_MAKE_OPERATOR_MANUAL(std::string,    string,     STRING,     array);
     SILVA_SERIALIZER_MAKE_OPERATOR_MANUAL(byte_vector,    byte_array, BYTE_ARRAY, array);
 
+    SILVA_SERIALIZER_MAKE_OPERATOR_MANUAL_WITH_OP(serialization::metadata::typed_array, typed_array, _serialize_typed_array_value(value));
+    SILVA_SERIALIZER_MAKE_OPERATOR_MANUAL_WITH_OP(serialization::metadata::record, record, _serialize_record_value(value));
+
     SILVA_SERIALIZER_MAKE_OPERATOR_MANUAL_WITH_OP(char *, cstring, *this << std::string(value));
     SILVA_SERIALIZER_MAKE_OPERATOR_MANUAL_WITH_OP(serialization::metadata::type_value, type_value, std::visit([&](auto&& arg) { *this << arg; }, value));
 
@@ -115,6 +222,93 @@ public:
 #undef SILVA_SERIALIZER_MAKE_OPERATOR_MANUAL_WITH_OP
 #undef SILVA_SERIALIZER_MAKE_OPERATOR_UNIMPLEMENTED
 
+    /**
+     * @brief Start a RECORD: the values serialized until the matching end_record() are nested in it
+     * @details The byte length of the record is written by end_record() so that readers can skip it in O(1),
+     *          records can be nested
+     */
+    serializer& begin_record()
+    {
+        m_buffer.push_back(serialization::metadata::type_chart::RECORD);
+        _pad_payload(sizeof(stdint::u64));
+        m_records.push_back(m_buffer.size());
+        m_buffer.resize(m_buffer.size() + sizeof(stdint::u64));
+        return *this;
+    }
+
+    /**
+     * @brief End the innermost record started with begin_record()
+     */
+    serializer& end_record()
+    {
+        if (m_records.empty())
+        {
+            throw error("No record to end");
+        }
+
+        const stdint::size_t offset = m_records.back();
+        m_records.pop_back();
+
+        const stdint::u64 length = m_buffer.size() - (offset + sizeof(stdint::u64));
+        const stdint::u64 archive_length = m_swap ? bit::swap_endian(length) : length;
+        std::memcpy(&m_buffer[offset], &archive_length, sizeof(stdint::u64));
+        return *this;
+    }
+
+    /**
+     * @brief Bulk encode a container of arithmetic values as one TYPED_ARRAY
+     * @details Contiguous containers in the archive byte order are written with a single memcpy
+     * @tparam Container A container of is_typed_array_element values (std::vector, std::deque, std::list, ...)
+     */
+    template<class Container>
+    serializer& serialize_typed_array(const Container& container)
+    {
+        using T = typename Container::value_type;
+        static_assert(serialization::metadata::is_typed_array_element<T>::value, "Only integral types and bool8 can be encoded as a typed array");
+
+        const stdint::u64 count = container.size();
+        const stdint::size_t offset = _begin_typed_array(serialization::metadata::type_chart_of<T>(), count, sizeof(T));
+        stdint::byte* out = m_buffer.data() + offset;
+
+        HL_IF_CONSTEXPR (std::is_same<Container, std::vector<T, typename Container::allocator_type>>::value && !std::is_same<T, bool>::value)
+        {
+            serialization::metadata::copy_elements(out, (const stdint::byte*)container.data(), count, sizeof(T), m_swap);
+            return *this;
+        }
+
+        for (const T& value : container)
+        {
+            const T archive_value = m_swap ? bit::swap_endian(value) : value;
+            std::memcpy(out, &archive_value, sizeof(T));
+            out += sizeof(T);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Encode a whole container: a TYPED_ARRAY for arithmetic values,
+     *        otherwise the element count (U64) followed by each element
+     */
+    template<class Container>
+    serializer& serialize_container(const Container& container)
+    {
+        using T = typename Container::value_type;
+
+        HL_IF_CONSTEXPR (serialization::metadata::is_typed_array_element<T>::value)
+        {
+            return serialize_typed_array(container);
+        }
+        else
+        {
+            *this << stdint::u64(container.size());
+            for (const T& value : container)
+            {
+                *this << value;
+            }
+            return *this;
+        }
+    }
+
     // wildcard section
     template<typename T>
     serializer& serialize(const T& value)
@@ -128,19 +322,75 @@ public:
         return *this << value;
     }
 
+    const serialization::metadata::archive_format& get_format() const
+    {
+        return m_format;
+    }
+
     const byte_vector &get_raw_buffer() const
     {
         return m_buffer;
     }
 
+    /**
+     * @brief Drop the serialized values but keep the allocated capacity to serialize a new archive
+     */
+    void clear()
+    {
+        m_buffer.clear();
+        m_records.clear();
+    }
+
+    /**
+     * @brief Exact size of the buffer returned by serialized_buffer() (header, values and END marker)
+     */
+    serialization::metadata::size_type serialized_size() const
+    {
+        const serialization::metadata::header_size_type size = m_buffer.size() + serialization::metadata::TYPE_CHART_SIZE;
+        return serialization::metadata::header_size(m_format, size) + size;
+    }
+
+    /**
+     * @brief Write the serialized archive directly into caller provided memory (e.g. a reserved ring buffer slot)
+     * @param out Where to write the archive
+     * @param capacity The number of bytes available at out
+     * @retval The number of bytes written (always serialized_size())
+     */
+    serialization::metadata::size_type write_serialized_buffer(stdint::byte* out, serialization::metadata::size_type capacity) const
+    {
+        const serialization::metadata::size_type total = serialized_size();
+
+        _check_records_ended();
+
+        if (capacity < total)
+        {
+            throw error("Output is too small to contain the serialized buffer");
+        }
+
+        serialization::metadata::header_byte_array header;
+        const serialization::metadata::size_type header_size = serialization::metadata::encode_header(header, m_magic, m_buffer.size() + serialization::metadata::TYPE_CHART_SIZE, m_format);
+
+        out = std::copy(header.begin(), header.begin() + header_size, out);
+        out = std::copy(m_buffer.begin(), m_buffer.end(), out);
+        *out = serialization::metadata::type_chart::END;
+
+        return total;
+    }
+
     byte_vector serialized_buffer() const
     {
-        byte_vector buffer = m_buffer;
+        _check_records_ended();
 
-        buffer.push_back(serialization::metadata::type_chart::END);
-        serialization::metadata::header_byte_array header = serialization::metadata::make_header(m_magic, buffer.size());
+        const serialization::metadata::header_size_type size = m_buffer.size() + serialization::metadata::TYPE_CHART_SIZE;
+        serialization::metadata::header_byte_array header;
+        const serialization::metadata::size_type header_size = serialization::metadata::encode_header(header, m_magic, size, m_format);
 
-        buffer.insert(buffer.begin(), header.begin(), header.end());
+        byte_vector buffer = m_pool != nullptr ? m_pool->acquire(header_size + size) : byte_vector();
+
+        buffer.reserve(header_size + size);
+        buffer.insert(buffer.end(), header.begin(), header.begin() + header_size);
+        buffer.insert(buffer.end(), m_buffer.begin(), m_buffer.end());
+        buffer.push_back(serialization::metadata::type_chart::END);
 
         return buffer;
     }
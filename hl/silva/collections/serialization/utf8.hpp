@@ -0,0 +1,368 @@
+/**
+ * hl/silva/collections/serialization/utf8.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/serialization/_base.hpp>
+
+// UTF-8 validation of STRING payloads, implementation of the "lookup" algorithm of
+// Keiser & Lemire (Validating UTF-8 In Less Than One Instruction Per Byte, 2021):
+// every byte is classified from its high nibble, the low nibble of the previous byte and
+// the high nibble of the previous byte with three 16 entries tables, the AND of the three
+// lookups is non zero only for invalid two byte sequences. Three and four byte sequences
+// are completed by checking that the continuation bytes expected after E_/F_ leads are there.
+//
+// The vectorized path is chosen at compile time (-mavx2 or -mssse3), define
+// SILVA_SERIALIZATION_UTF8_FORCE_SCALAR to always use the byte by byte validator.
+
+#if !defined(SILVA_SERIALIZATION_UTF8_FORCE_SCALAR)
+#if defined(__AVX2__)
+#define SILVA_SERIALIZATION_UTF8_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#define SILVA_SERIALIZATION_UTF8_SSSE3 1
+#include <tmmintrin.h>
+#endif
+#endif
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace serialization
+{
+
+/**
+ * @brief invalid_utf8_error Thrown by the deserializer when a STRING payload is not valid UTF-8
+ */
+class invalid_utf8_error : public error
+{
+private:
+    stdint::size_t _offset;
+
+public:
+    invalid_utf8_error(const std::string& message, stdint::size_t offset)
+        : error(message)
+        , _offset(offset)
+    {}
+
+    /**
+     * @brief Offset of the invalid string value in the archive
+     */
+    stdint::size_t offset() const noexcept
+    {
+        return _offset;
+    }
+};
+
+namespace utf8
+{
+
+/**
+ * @brief Byte by byte UTF-8 validation (rejects overlongs, surrogates and code points above U+10FFFF)
+ */
+static inline bool validate_scalar(const stdint::byte* data, stdint::size_t size)
+{
+    stdint::size_t i = 0;
+
+    while (i < size)
+    {
+        const stdint::byte lead = data[i];
+
+        if (lead < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        stdint::size_t length;
+        stdint::byte min = 0x80, max = 0xBF; // range of the first continuation byte
+
+        if (lead >= 0xC2 && lead <= 0xDF)
+        {
+            length = 2;
+        }
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            length = 3;
+            if (lead == 0xE0) min = 0xA0;
+            if (lead == 0xED) max = 0x9F;
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            length = 4;
+            if (lead == 0xF0) min = 0x90;
+            if (lead == 0xF4) max = 0x8F;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (length > size - i || data[i + 1] < min || data[i + 1] > max)
+        {
+            return false;
+        }
+        for (stdint::size_t k = 2; k < length; k++)
+        {
+            if ((data[i + k] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+// classification bits of the lookup tables, a pair of bytes is invalid when the three lookups share a bit
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _TOO_SHORT      = 1 << 0; // 11______ 0_______ or 11______ 11______
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _TOO_LONG       = 1 << 1; // 0_______ 10______
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _OVERLONG_3     = 1 << 2; // 11100000 100_____
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _TOO_LARGE      = 1 << 3; // 11110100 1001____ and above
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _SURROGATE      = 1 << 4; // 11101101 101_____
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _OVERLONG_2     = 1 << 5; // 1100000_ 10______
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _TOO_LARGE_1000 = 1 << 6; // 11110101 1000____ and above
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _OVERLONG_4     = 1 << 6; // 11110000 1000____
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _TWO_CONTS      = 1 << 7; // 10______ 10______ (valid after E_/F_ leads)
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _CARRY          = _TOO_SHORT | _TOO_LONG | _TWO_CONTS;
+
+// indexed by the high nibble of the previous byte
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _BYTE_1_HIGH[16] = {
+    _TOO_LONG, _TOO_LONG, _TOO_LONG, _TOO_LONG,
+    _TOO_LONG, _TOO_LONG, _TOO_LONG, _TOO_LONG,
+    _TWO_CONTS, _TWO_CONTS, _TWO_CONTS, _TWO_CONTS,
+    _TOO_SHORT | _OVERLONG_2,
+    _TOO_SHORT,
+    _TOO_SHORT | _OVERLONG_3 | _SURROGATE,
+    _TOO_SHORT | _TOO_LARGE | _TOO_LARGE_1000 | _OVERLONG_4,
+};
+
+// indexed by the low nibble of the previous byte
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _BYTE_1_LOW[16] = {
+    _CARRY | _OVERLONG_3 | _OVERLONG_2 | _OVERLONG_4,
+    _CARRY | _OVERLONG_2,
+    _CARRY,
+    _CARRY,
+    _CARRY | _TOO_LARGE,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000 | _SURROGATE,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+    _CARRY | _TOO_LARGE | _TOO_LARGE_1000,
+};
+
+// indexed by the high nibble of the current byte
+HL_INLINE_CONSTEXPR_VARIABLE stdint::byte _BYTE_2_HIGH[16] = {
+    _TOO_SHORT, _TOO_SHORT, _TOO_SHORT, _TOO_SHORT,
+    _TOO_SHORT, _TOO_SHORT, _TOO_SHORT, _TOO_SHORT,
+    _TOO_LONG | _OVERLONG_2 | _TWO_CONTS | _OVERLONG_3 | _TOO_LARGE_1000 | _OVERLONG_4,
+    _TOO_LONG | _OVERLONG_2 | _TWO_CONTS | _OVERLONG_3 | _TOO_LARGE,
+    _TOO_LONG | _OVERLONG_2 | _TWO_CONTS | _SURROGATE | _TOO_LARGE,
+    _TOO_LONG | _OVERLONG_2 | _TWO_CONTS | _SURROGATE | _TOO_LARGE,
+    _TOO_SHORT, _TOO_SHORT, _TOO_SHORT, _TOO_SHORT,
+};
+
+#if defined(SILVA_SERIALIZATION_UTF8_AVX2)
+
+// the same 16 entries are needed in both 128 bits lanes for vpshufb
+static inline __m256i _load_table(const stdint::byte (&table)[16])
+{
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table));
+}
+
+static inline __m256i _high_nibbles(const __m256i& input)
+{
+    return _mm256_and_si256(_mm256_srli_epi16(input, 4), _mm256_set1_epi8(0x0F));
+}
+
+// bytes of input shifted by N positions, the first N bytes come from the end of previous
+template<int N>
+static inline __m256i _prev(const __m256i& input, const __m256i& previous)
+{
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+}
+
+static inline bool _validate_avx2(const stdint::byte* data, stdint::size_t size)
+{
+    const __m256i byte_1_high_table = _load_table(_BYTE_1_HIGH);
+    const __m256i byte_1_low_table = _load_table(_BYTE_1_LOW);
+    const __m256i byte_2_high_table = _load_table(_BYTE_2_HIGH);
+    const __m256i low_nibble_mask = _mm256_set1_epi8(0x0F);
+    // a lead byte in the last 3 positions still waits for its continuation bytes
+    const __m256i incomplete_max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+
+    __m256i previous = _mm256_setzero_si256();
+    __m256i previous_incomplete = _mm256_setzero_si256();
+    __m256i errors = _mm256_setzero_si256();
+
+    auto check_block = [&](const __m256i& input)
+    {
+        if (_mm256_movemask_epi8(input) == 0)
+        {
+            // ASCII only: the block is valid as long as the previous one did not end in the middle of a sequence
+            errors = _mm256_or_si256(errors, previous_incomplete);
+        }
+        else
+        {
+            const __m256i prev1 = _prev<1>(input, previous);
+            const __m256i special = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8(byte_1_high_table, _high_nibbles(prev1)),
+                    _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, low_nibble_mask))),
+                _mm256_shuffle_epi8(byte_2_high_table, _high_nibbles(input)));
+
+            // 0x80 set where the byte must be the 2nd/3rd continuation of a E_/F_ lead
+            const __m256i third = _mm256_subs_epu8(_prev<2>(input, previous), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+            const __m256i fourth = _mm256_subs_epu8(_prev<3>(input, previous), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+            const __m256i must_23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+
+            errors = _mm256_or_si256(errors, _mm256_xor_si256(must_23, special));
+            previous_incomplete = _mm256_subs_epu8(input, incomplete_max);
+        }
+        previous = input;
+    };
+
+    stdint::size_t i = 0;
+
+    for (; i + sizeof(__m256i) <= size; i += sizeof(__m256i))
+    {
+        check_block(_mm256_loadu_si256((const __m256i*)(data + i)));
+    }
+
+    if (i < size)
+    {
+        // zero padded last block, a truncated sequence is then followed by ASCII and flagged TOO_SHORT
+        stdint::byte last[sizeof(__m256i)] = {};
+        std::memcpy(last, data + i, size - i);
+        check_block(_mm256_loadu_si256((const __m256i*)last));
+    }
+
+    errors = _mm256_or_si256(errors, previous_incomplete);
+    return _mm256_testz_si256(errors, errors);
+}
+
+#elif defined(SILVA_SERIALIZATION_UTF8_SSSE3)
+
+static inline __m128i _high_nibbles(const __m128i& input)
+{
+    return _mm_and_si128(_mm_srli_epi16(input, 4), _mm_set1_epi8(0x0F));
+}
+
+static inline bool _validate_ssse3(const stdint::byte* data, stdint::size_t size)
+{
+    const __m128i byte_1_high_table = _mm_loadu_si128((const __m128i*)_BYTE_1_HIGH);
+    const __m128i byte_1_low_table = _mm_loadu_si128((const __m128i*)_BYTE_1_LOW);
+    const __m128i byte_2_high_table = _mm_loadu_si128((const __m128i*)_BYTE_2_HIGH);
+    const __m128i low_nibble_mask = _mm_set1_epi8(0x0F);
+    // a lead byte in the last 3 positions still waits for its continuation bytes
+    const __m128i incomplete_max = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+
+    __m128i previous = _mm_setzero_si128();
+    __m128i previous_incomplete = _mm_setzero_si128();
+    __m128i errors = _mm_setzero_si128();
+
+    auto check_block = [&](const __m128i& input)
+    {
+        if (_mm_movemask_epi8(input) == 0)
+        {
+            // ASCII only: the block is valid as long as the previous one did not end in the middle of a sequence
+            errors = _mm_or_si128(errors, previous_incomplete);
+        }
+        else
+        {
+            const __m128i prev1 = _mm_alignr_epi8(input, previous, 16 - 1);
+            const __m128i special = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_shuffle_epi8(byte_1_high_table, _high_nibbles(prev1)),
+                    _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, low_nibble_mask))),
+                _mm_shuffle_epi8(byte_2_high_table, _high_nibbles(input)));
+
+            // 0x80 set where the byte must be the 2nd/3rd continuation of a E_/F_ lead
+            const __m128i third = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 16 - 2), _mm_set1_epi8((char)(0xE0 - 0x80)));
+            const __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 16 - 3), _mm_set1_epi8((char)(0xF0 - 0x80)));
+            const __m128i must_23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+
+            errors = _mm_or_si128(errors, _mm_xor_si128(must_23, special));
+            previous_incomplete = _mm_subs_epu8(input, incomplete_max);
+        }
+        previous = input;
+    };
+
+    stdint::size_t i = 0;
+
+    for (; i + sizeof(__m128i) <= size; i += sizeof(__m128i))
+    {
+        check_block(_mm_loadu_si128((const __m128i*)(data + i)));
+    }
+
+    if (i < size)
+    {
+        // zero padded last block, a truncated sequence is then followed by ASCII and flagged TOO_SHORT
+        stdint::byte last[sizeof(__m128i)] = {};
+        std::memcpy(last, data + i, size - i);
+        check_block(_mm_loadu_si128((const __m128i*)last));
+    }
+
+    errors = _mm_or_si128(errors, previous_incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(errors, _mm_setzero_si128())) == 0xFFFF;
+}
+
+#endif
+
+/**
+ * @brief Check that size bytes starting at data are valid UTF-8
+ * @retval true when the bytes are valid UTF-8 (an empty range is valid)
+ */
+static inline bool validate(const stdint::byte* data, stdint::size_t size)
+{
+#if defined(SILVA_SERIALIZATION_UTF8_AVX2)
+    return _validate_avx2(data, size);
+#elif defined(SILVA_SERIALIZATION_UTF8_SSSE3)
+    return _validate_ssse3(data, size);
+#else
+    return validate_scalar(data, size);
+#endif
+}
+
+static inline bool validate(const std::string& value)
+{
+    return validate((const stdint::byte*)value.data(), value.size());
+}
+
+}
+}
+}
+}
+}
@@ -134,6 +134,21 @@ public:
         return thread_safe_iterable<list>(m_mutex, m_list);
     }
 
+    // Gives access to the whole underlying container under a single lock (e.g. for bulk operations)
+    // The lock is held as long as the result is alive
+
+    thread_safe_result<base_type_t> locked_base()
+    {
+        thread_safe_result_lock lock(m_mutex);
+        return thread_safe_result<base_type_t>(std::move(lock), m_list);
+    }
+
+    thread_safe_result<const base_type_t> locked_base() const
+    {
+        thread_safe_result_lock lock(m_mutex);
+        return thread_safe_result<const base_type_t>(std::move(lock), m_list);
+    }
+
     template<class... Args>
     iterator emplace(iterator pos, Args&&... args)
     {
@@ -49,6 +49,7 @@ private:
     using deque<T, Allocator>::resize;
     using deque<T, Allocator>::poll_back;
     using deque<T, Allocator>::iter;
+    using deque<T, Allocator>::locked_base;
 
 public:
     using size_type = typename deque<T, Allocator>::size_type;
@@ -25,4 +25,17 @@
 
 #include <hl/silva/collections/threads/basic_pool.hpp>
 #include <hl/silva/collections/threads/basic_pool_async.hpp>
+#include <hl/silva/collections/threads/chase_lev_deque.hpp>
+#include <hl/silva/collections/threads/device_arena.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
+#include <hl/silva/collections/threads/fixed_pool.hpp>
+#include <hl/silva/collections/threads/future.hpp>
+#include <hl/silva/collections/threads/gpu_atomic.hpp>
 #include <hl/silva/collections/threads/gpu_sim.hpp>
+#include <hl/silva/collections/threads/lane_vector.hpp>
+#include <hl/silva/collections/threads/parallel.hpp>
+#include <hl/silva/collections/threads/stream.hpp>
+#include <hl/silva/collections/threads/task.hpp>
+#include <hl/silva/collections/threads/task_graph.hpp>
+#include <hl/silva/collections/threads/traversal.hpp>
+#include <hl/silva/collections/threads/work_stealing_pool.hpp>
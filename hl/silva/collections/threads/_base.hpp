@@ -27,6 +27,11 @@
 #include <condition_variable>
 #include <atomic>
 
+// Used to keep data written by different threads on different cache lines
+#ifndef SILVA_THREADS_CACHE_LINE_SIZE
+#define SILVA_THREADS_CACHE_LINE_SIZE 64
+#endif
+
 namespace hl
 {
 namespace silva
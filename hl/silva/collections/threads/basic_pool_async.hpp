@@ -24,6 +24,7 @@
 #pragma once
 
 #include <hl/silva/collections/threads/basic_pool.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
 #include <atomic>
 
 namespace hl
@@ -35,7 +36,7 @@ namespace collections
 namespace threads
 {
 
-class basic_pool_async
+class basic_pool_async : public executor
 {
 private:
     atomic_bool m_stop;
@@ -162,16 +163,45 @@ public:
         return m_pool.empty();
     }
 
-    ~basic_pool_async()
+    virtual ~basic_pool_async() override
     {
         stop();
     }
 
+    /**
+     * @brief One thread is created per task, reports the hardware concurrency
+     */
+    virtual size_t concurrency() const override
+    {
+        const size_t count = thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
     template <bool IncludeDoneNotRemoved = false>
     size_t pending_threads()
     {
         return m_pool.pending_threads<IncludeDoneNotRemoved>();
     }
+
+protected:
+    virtual bool _post(task&& t) override
+    {
+        thread_safe::lock_guard lock(m_mutex_flow);
+
+        if (m_stop)
+        {
+            return false;
+        }
+
+        m_pool.push(
+            [this](task &&thread_task)
+            {
+                thread_task();
+                m_has_event = true;
+                m_condition.notify_one();
+            }, std::move(t));
+        return true;
+    }
 };
 
 }
@@ -0,0 +1,216 @@
+/**
+ * hl/silva/collections/threads/chase_lev_deque.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/stdint.hpp>
+#include <hl/silva/collections/meta.hpp>
+
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+#ifndef SILVA_THREADS_DEQUE_INITIAL_CAPACITY
+#define SILVA_THREADS_DEQUE_INITIAL_CAPACITY 256
+#endif
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+/**
+ * @brief chase_lev_deque Lock free work stealing deque (Chase & Lev, with the C11 orderings of Le et al.)
+ * @details One owner thread pushes and pops at the bottom (LIFO), any thread steals from the top (FIFO).
+ *          The ring grows when full, the previous rings are kept until destruction because a thief may still read them.
+ * @tparam T a trivially copyable element (usually a pointer)
+ */
+template<typename T>
+class chase_lev_deque : public meta::NonCopyMoveable
+{
+    static_assert(std::is_trivially_copyable<T>::value, "chase_lev_deque elements must be trivially copyable");
+
+private:
+    class ring
+    {
+    private:
+        std::size_t m_mask;
+        std::unique_ptr<atomic<T>[]> m_slots;
+
+    public:
+        ring(std::size_t capacity)
+            : m_mask(capacity - 1)
+            , m_slots(new atomic<T>[capacity])
+        {}
+
+        std::size_t capacity() const
+        {
+            return m_mask + 1;
+        }
+
+        T load(stdint::i64 index) const
+        {
+            return m_slots[std::size_t(index) & m_mask].load(std::memory_order_relaxed);
+        }
+
+        void store(stdint::i64 index, T value)
+        {
+            m_slots[std::size_t(index) & m_mask].store(value, std::memory_order_relaxed);
+        }
+    };
+
+    alignas(SILVA_THREADS_CACHE_LINE_SIZE) atomic<stdint::i64> m_top;
+    alignas(SILVA_THREADS_CACHE_LINE_SIZE) atomic<stdint::i64> m_bottom;
+    atomic<ring*> m_ring;
+
+    // owner only
+    std::vector<std::unique_ptr<ring>> m_rings;
+
+public:
+    /**
+     * @param capacity the initial capacity, rounded up to a power of two
+     */
+    chase_lev_deque(std::size_t capacity = SILVA_THREADS_DEQUE_INITIAL_CAPACITY)
+        : m_top(0)
+        , m_bottom(0)
+        , m_ring(nullptr)
+        , m_rings()
+    {
+        std::size_t rounded = 1;
+
+        while (rounded < capacity)
+        {
+            rounded <<= 1;
+        }
+        m_rings.emplace_back(new ring(rounded));
+        m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+    }
+
+    virtual ~chase_lev_deque() override = default;
+
+    /**
+     * @brief Push at the bottom, owner only
+     */
+    void push(T value)
+    {
+        const stdint::i64 bottom = m_bottom.load(std::memory_order_relaxed);
+        const stdint::i64 top = m_top.load(std::memory_order_acquire);
+        ring* current = m_ring.load(std::memory_order_relaxed);
+
+        if (bottom - top > stdint::i64(current->capacity()) - 1)
+        {
+            current = _grow(current, bottom, top);
+        }
+        current->store(bottom, value);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Pop the last pushed value, owner only
+     * @retval false when the deque is empty
+     */
+    bool pop(T& value)
+    {
+        const stdint::i64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        ring* current = m_ring.load(std::memory_order_relaxed);
+
+        // seq_cst store then load instead of the fence of the paper (same guarantee, understood by ThreadSanitizer)
+        m_bottom.store(bottom, std::memory_order_seq_cst);
+        stdint::i64 top = m_top.load(std::memory_order_seq_cst);
+
+        if (top > bottom)
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        value = current->load(bottom);
+        if (top == bottom)
+        {
+            // last element, race against the thieves
+            const bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest value, any thread
+     * @retval false when the deque is empty or another thread took the value first
+     */
+    bool steal(T& value)
+    {
+        stdint::i64 top = m_top.load(std::memory_order_seq_cst);
+        const stdint::i64 bottom = m_bottom.load(std::memory_order_seq_cst);
+
+        if (top >= bottom)
+        {
+            return false;
+        }
+
+        const ring* current = m_ring.load(std::memory_order_acquire);
+        value = current->load(top);
+        return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Approximate number of values (exact for the owner when no thief is running)
+     */
+    std::size_t size() const
+    {
+        const stdint::i64 bottom = m_bottom.load(std::memory_order_relaxed);
+        const stdint::i64 top = m_top.load(std::memory_order_relaxed);
+
+        return bottom > top ? std::size_t(bottom - top) : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    ring* _grow(ring* current, stdint::i64 bottom, stdint::i64 top)
+    {
+        m_rings.emplace_back(new ring(current->capacity() * 2));
+        ring* bigger = m_rings.back().get();
+
+        for (stdint::i64 i = top; i < bottom; i++)
+        {
+            bigger->store(i, current->load(i));
+        }
+        m_ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+};
+
+}
+}
+}
+}
@@ -0,0 +1,249 @@
+/**
+ * hl/silva/collections/threads/device_arena.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
+#include <hl/silva/collections/threads/parallel.hpp>
+#include <hl/silva/collections/thread_safe/_base.hpp>
+#include <hl/silva/collections/meta.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+// Size of the chunks a device_arena takes from the system, a bigger allocation gets a chunk of its own
+#ifndef SILVA_THREADS_DEVICE_ARENA_CHUNK_SIZE
+#define SILVA_THREADS_DEVICE_ARENA_CHUNK_SIZE (std::size_t(64) << 20)
+#endif
+
+// Default alignment of device allocations (cudaMalloc guarantees 256 bytes)
+#ifndef SILVA_THREADS_DEVICE_ARENA_ALIGNMENT
+#define SILVA_THREADS_DEVICE_ARENA_ALIGNMENT 256
+#endif
+
+// Pages of a new chunk are first written by the workers (first touch), 0 to leave them to the first user
+#ifndef SILVA_THREADS_DEVICE_ARENA_FIRST_TOUCH
+#define SILVA_THREADS_DEVICE_ARENA_FIRST_TOUCH 1
+#endif
+
+// Bytes of a new chunk touched by one worker at a time (a multiple of the page size)
+#ifndef SILVA_THREADS_DEVICE_ARENA_TOUCH_GRAIN
+#define SILVA_THREADS_DEVICE_ARENA_TOUCH_GRAIN (std::size_t(256) << 10)
+#endif
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+/**
+ * @brief device_arena Emulated device memory: aligned bump allocation in big chunks
+ * @details An allocation is a pointer bump under a lock, the system is only asked for a new chunk when the current
+ *          one is full. free() does nothing, reset() gives back everything at once and keeps the chunks for the
+ *          next allocations. New chunks are zeroed by the workers of the executor, in parallel: with the first touch
+ *          policy of Linux their pages are spread over the NUMA nodes of the workers instead of all landing on
+ *          the node of the allocating thread.
+ */
+class device_arena : public meta::NonCopyMoveable
+{
+private:
+    struct chunk
+    {
+        std::unique_ptr<unsigned char[]> memory;
+        std::size_t size;
+    };
+
+    executor& m_executor;
+    std::size_t m_chunk_size;
+
+    thread_safe::mutex m_mutex;
+    std::vector<chunk> m_chunks;
+    std::size_t m_current;      // chunk being bumped
+    std::size_t m_offset;       // in the current chunk
+    std::size_t m_used;         // bytes handed out since the last reset, padding included
+
+public:
+    /**
+     * @param ex the executor touching the new chunks first
+     * @param chunk_size the size of the chunks taken from the system
+     */
+    device_arena(executor& ex, std::size_t chunk_size = SILVA_THREADS_DEVICE_ARENA_CHUNK_SIZE)
+        : m_executor(ex)
+        , m_chunk_size(chunk_size == 0 ? 1 : chunk_size)
+        , m_mutex()
+        , m_chunks()
+        , m_current(0)
+        , m_offset(0)
+        , m_used(0)
+    {}
+
+    virtual ~device_arena() override = default;
+
+    /**
+     * @brief Allocate bytes aligned on alignment (a power of two), the memory is not initialized
+     */
+    void* allocate(std::size_t bytes, std::size_t alignment = SILVA_THREADS_DEVICE_ARENA_ALIGNMENT)
+    {
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        {
+            throw std::invalid_argument("device_arena: the alignment must be a power of two");
+        }
+
+        thread_safe::lock_guard lock(m_mutex);
+
+        while (m_current < m_chunks.size())
+        {
+            void* memory = _bump(m_chunks[m_current], bytes, alignment);
+
+            if (memory != nullptr)
+            {
+                return memory;
+            }
+            m_current++;
+            m_offset = 0;
+        }
+
+        const std::size_t needed = bytes + alignment - 1;
+
+        m_chunks.push_back(_make_chunk(needed > m_chunk_size ? needed : m_chunk_size));
+        m_current = m_chunks.size() - 1;
+        m_offset = 0;
+        return _bump(m_chunks[m_current], bytes, alignment);
+    }
+
+    /**
+     * @brief Allocate count uninitialized T
+     */
+    template<typename T>
+    T* allocate_array(std::size_t count)
+    {
+        static_assert(std::is_trivially_default_constructible<T>::value && std::is_trivially_destructible<T>::value,
+            "device_arena holds trivial types");
+
+        const std::size_t alignment = alignof(T) > SILVA_THREADS_DEVICE_ARENA_ALIGNMENT ? alignof(T) : SILVA_THREADS_DEVICE_ARENA_ALIGNMENT;
+
+        return static_cast<T*>(allocate(count * sizeof(T), alignment));
+    }
+
+    /**
+     * @brief Does nothing, the memory comes back with reset()
+     */
+    void free(void*)
+    {}
+
+    /**
+     * @brief Give back every allocation at once, the chunks are kept for the next ones
+     * @details Nothing allocated before must be used anymore (nor by a pending copy or kernel)
+     */
+    void reset()
+    {
+        thread_safe::lock_guard lock(m_mutex);
+
+        m_current = 0;
+        m_offset = 0;
+        m_used = 0;
+    }
+
+    /**
+     * @brief Give the chunks back to the system
+     */
+    void release()
+    {
+        thread_safe::lock_guard lock(m_mutex);
+
+        m_chunks.clear();
+        m_current = 0;
+        m_offset = 0;
+        m_used = 0;
+    }
+
+    /**
+     * @brief Bytes allocated since the last reset, alignment padding included
+     */
+    std::size_t used()
+    {
+        thread_safe::lock_guard lock(m_mutex);
+        return m_used;
+    }
+
+    /**
+     * @brief Bytes taken from the system
+     */
+    std::size_t capacity()
+    {
+        thread_safe::lock_guard lock(m_mutex);
+        std::size_t total = 0;
+
+        for (const chunk& c : m_chunks)
+        {
+            total += c.size;
+        }
+        return total;
+    }
+
+private:
+    void* _bump(chunk& c, std::size_t bytes, std::size_t alignment)
+    {
+        const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(c.memory.get());
+        const std::uintptr_t aligned = (base + m_offset + alignment - 1) & ~std::uintptr_t(alignment - 1);
+        const std::size_t begin = std::size_t(aligned - base);
+
+        if (begin > c.size || bytes > c.size - begin)
+        {
+            return nullptr;
+        }
+
+        m_used += begin + bytes - m_offset;
+        m_offset = begin + bytes;
+        return c.memory.get() + begin;
+    }
+
+    chunk _make_chunk(std::size_t size)
+    {
+        chunk c { std::unique_ptr<unsigned char[]>(new unsigned char[size]), size };
+
+#if SILVA_THREADS_DEVICE_ARENA_FIRST_TOUCH
+        unsigned char* memory = c.memory.get();
+
+        parallel_for(m_executor, blocked_range<std::size_t>(0, size, SILVA_THREADS_DEVICE_ARENA_TOUCH_GRAIN),
+            [memory](const blocked_range<std::size_t>& pages) {
+                std::memset(memory + pages.begin(), 0, pages.size());
+            });
+#endif
+        return c;
+    }
+};
+
+}
+}
+}
+}
@@ -0,0 +1,114 @@
+/**
+ * hl/silva/collections/threads/executor.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/task.hpp>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+template<typename T>
+class future;
+
+/**
+ * @brief executor Something that runs tasks on a set of worker threads
+ */
+class executor
+{
+public:
+    HL_INLINE_CONSTEXPR_VARIABLE std::size_t npos = std::size_t(-1);
+
+    virtual ~executor() = default;
+
+    /**
+     * @brief Queue a task
+     * @retval false when the executor does not accept tasks anymore (t is left untouched)
+     */
+    bool post(task&& t)
+    {
+        return _post(std::move(t));
+    }
+
+    template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, task>::value>::type>
+    bool post(F&& f)
+    {
+        return _post(task(std::forward<F>(f)));
+    }
+
+    /**
+     * @brief Queue f and get a future of its result (defined in future.hpp)
+     * @details The future gets std::future_errc::broken_promise when the executor does not accept tasks anymore
+     */
+    template<typename F>
+    auto submit(F&& f);
+
+    /**
+     * @brief Number of worker threads
+     */
+    virtual std::size_t concurrency() const = 0;
+
+    /**
+     * @brief Index (in [0, concurrency())) of the calling worker thread, npos when called from another thread
+     */
+    std::size_t worker_index() const
+    {
+        const worker_slot& slot = _current_worker();
+        return slot.owner == this ? slot.index : npos;
+    }
+
+protected:
+    struct worker_slot
+    {
+        const executor* owner;
+        std::size_t index;
+    };
+
+    virtual bool _post(task&& t) = 0;
+
+    static worker_slot& _current_worker()
+    {
+        static thread_local worker_slot slot = { nullptr, npos };
+        return slot;
+    }
+
+    // to call first thing in each worker thread
+    void _register_worker(std::size_t index) const
+    {
+        _current_worker() = { this, index };
+    }
+};
+
+}
+}
+}
+}
+
+// defines executor::submit
+#include <hl/silva/collections/threads/future.hpp>
@@ -0,0 +1,300 @@
+/**
+ * hl/silva/collections/threads/fixed_pool.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
+#include <hl/silva/collections/thread_safe/_base.hpp>
+#include <hl/silva/collections/meta.hpp>
+
+#include <mutex>
+#include <vector>
+#include <exception>
+
+#ifndef SILVA_THREADS_FIXED_POOL_DEFAULT_QUEUE_CAPACITY
+#define SILVA_THREADS_FIXED_POOL_DEFAULT_QUEUE_CAPACITY 1024
+#endif
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+/**
+ * @brief fixed_pool N persistent worker threads pulling tasks from a bounded queue
+ * @details Posting a task is a move into a ring buffer, the threads are created once in the constructor.
+ *          When the queue is full post blocks until a worker takes a task (backpressure), unless it is called
+ *          from one of the workers, in which case the task runs inline instead of deadlocking the pool.
+ */
+class fixed_pool : public executor, public meta::NonCopyMoveable
+{
+private:
+    mutable thread_safe::mutex m_mutex;
+    condition_variable m_not_empty;
+    condition_variable m_not_full;
+    condition_variable m_idle;
+
+    // ring buffer
+    std::vector<task> m_queue;
+    std::size_t m_head;
+    std::size_t m_count;
+
+    std::size_t m_running;
+    bool m_stopping;
+    std::exception_ptr m_error;
+
+    std::vector<thread> m_workers;
+
+public:
+    /**
+     * @brief Construct a new fixed pool object and start its workers
+     * @param workers the number of worker threads (0 means one per hardware thread)
+     * @param queue_capacity the number of tasks that can wait in the queue before post blocks
+     */
+    fixed_pool(std::size_t workers = 0, std::size_t queue_capacity = SILVA_THREADS_FIXED_POOL_DEFAULT_QUEUE_CAPACITY)
+        : m_queue(queue_capacity == 0 ? 1 : queue_capacity)
+        , m_head(0)
+        , m_count(0)
+        , m_running(0)
+        , m_stopping(false)
+        , m_error()
+        , m_workers()
+    {
+        if (workers == 0)
+        {
+            workers = thread::hardware_concurrency();
+            workers = workers == 0 ? 1 : workers;
+        }
+
+        m_workers.reserve(workers);
+        for (std::size_t i = 0; i < workers; i++)
+        {
+            m_workers.emplace_back(&fixed_pool::_worker, this, i);
+        }
+    }
+
+    virtual ~fixed_pool() override
+    {
+        shutdown();
+    }
+
+    using executor::post;
+
+    /**
+     * @brief Queue a task without blocking
+     * @retval false when the queue is full or the pool is shut down (the task is dropped)
+     */
+    bool try_post(task&& t)
+    {
+        {
+            thread_safe::lock_guard lock(m_mutex);
+
+            if (m_stopping || m_count == m_queue.size())
+            {
+                return false;
+            }
+            _push(std::move(t));
+        }
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, task>::value>::type>
+    bool try_post(F&& f)
+    {
+        return try_post(task(std::forward<F>(f)));
+    }
+
+    /**
+     * @brief Wait until the queue is empty and no task is running
+     * @details Rethrows the first exception thrown by a task since the last call, must not be called from a worker
+     */
+    void wait_idle()
+    {
+        std::exception_ptr error;
+        {
+            std::unique_lock<thread_safe::mutex> lock(m_mutex);
+
+            m_idle.wait(lock, [this]() { return m_count == 0 && m_running == 0; });
+            std::swap(error, m_error);
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /**
+     * @brief Stop accepting tasks and join the workers, called by the destructor
+     * @param drain run the queued tasks before stopping, otherwise they are dropped
+     * @details Blocked posters are woken up and return false, must not be called from a worker
+     */
+    void shutdown(bool drain = true)
+    {
+        std::vector<task> dropped;
+        {
+            thread_safe::lock_guard lock(m_mutex);
+
+            m_stopping = true;
+            if (!drain)
+            {
+                dropped.reserve(m_count);
+                while (m_count != 0)
+                {
+                    dropped.push_back(_pop());
+                }
+            }
+        }
+        m_not_empty.notify_all();
+        m_not_full.notify_all();
+
+        for (thread& worker : m_workers)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+        // dropped tasks are destroyed here, outside the lock
+    }
+
+    virtual std::size_t concurrency() const override
+    {
+        return m_workers.size();
+    }
+
+    std::size_t queue_capacity() const
+    {
+        return m_queue.size();
+    }
+
+    /**
+     * @brief Number of tasks queued or running
+     */
+    std::size_t pending() const
+    {
+        thread_safe::lock_guard lock(m_mutex);
+        return m_count + m_running;
+    }
+
+protected:
+    virtual bool _post(task&& t) override
+    {
+        {
+            std::unique_lock<thread_safe::mutex> lock(m_mutex);
+
+            if (m_count == m_queue.size() && !m_stopping && worker_index() != npos)
+            {
+                // a worker waiting for room would wait for itself
+                lock.unlock();
+                _run(t);
+                return true;
+            }
+
+            m_not_full.wait(lock, [this]() { return m_stopping || m_count < m_queue.size(); });
+            if (m_stopping)
+            {
+                return false;
+            }
+            _push(std::move(t));
+        }
+        m_not_empty.notify_one();
+        return true;
+    }
+
+private:
+    // requires m_mutex
+    void _push(task&& t)
+    {
+        m_queue[(m_head + m_count) % m_queue.size()] = std::move(t);
+        m_count++;
+    }
+
+    // requires m_mutex
+    task _pop()
+    {
+        task t = std::move(m_queue[m_head]);
+        m_head = (m_head + 1) % m_queue.size();
+        m_count--;
+        return t;
+    }
+
+    void _run(task& t)
+    {
+        try
+        {
+            t();
+        }
+        catch (...)
+        {
+            thread_safe::lock_guard lock(m_mutex);
+
+            if (!m_error)
+            {
+                m_error = std::current_exception();
+            }
+        }
+        t.reset();
+    }
+
+    void _worker(std::size_t index)
+    {
+        _register_worker(index);
+
+        std::unique_lock<thread_safe::mutex> lock(m_mutex);
+
+        while (true)
+        {
+            m_not_empty.wait(lock, [this]() { return m_stopping || m_count != 0; });
+            if (m_count == 0)
+            {
+                return; // stopping and drained
+            }
+
+            task t = _pop();
+            m_running++;
+            lock.unlock();
+            m_not_full.notify_one();
+
+            _run(t);
+
+            lock.lock();
+            m_running--;
+            if (m_count == 0 && m_running == 0)
+            {
+                m_idle.notify_all();
+            }
+        }
+    }
+};
+
+}
+}
+}
+}
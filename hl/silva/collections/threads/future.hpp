@@ -0,0 +1,917 @@
+/**
+ * hl/silva/collections/threads/future.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/threads/task.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
+#include <hl/silva/collections/thread_safe/_base.hpp>
+#include <hl/silva/collections/stdint.hpp>
+
+#include <mutex>
+#include <future>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <exception>
+#include <type_traits>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+template<typename T>
+class future;
+
+template<typename T>
+class promise;
+
+template<typename T>
+struct when_any_result;
+
+/**
+ * @brief Value stored by a future<void>
+ */
+struct void_result {};
+
+// T as stored in a future, and how a continuation receives it
+template<typename T>
+struct future_value
+{
+    using type = T;
+
+    template<typename F>
+    using result = decltype(std::declval<F&>()(std::declval<T&&>()));
+
+    static T get(type&& value)
+    {
+        return std::move(value);
+    }
+
+    template<typename F>
+    static result<F> invoke(F& f, type&& value)
+    {
+        return f(std::move(value));
+    }
+};
+
+template<>
+struct future_value<void>
+{
+    using type = void_result;
+
+    template<typename F>
+    using result = decltype(std::declval<F&>()());
+
+    static void get(type&&)
+    {}
+
+    template<typename F>
+    static result<F> invoke(F& f, type&&)
+    {
+        return f();
+    }
+};
+
+// a continuation returning a future<U> gives a future<U>, not a future<future<U>>
+template<typename R>
+struct future_unwrap
+{
+    using type = R;
+};
+
+template<typename U>
+struct future_unwrap<future<U>>
+{
+    using type = U;
+};
+
+/**
+ * @brief shared_state State shared by a promise (or a submitted task) and its future
+ * @details Reference counted in place, so a submission costs one allocation. Holds at most one continuation,
+ *          which runs in the thread that completes the state (or right away when it is already complete).
+ */
+template<typename T>
+class shared_state
+{
+public:
+    using value_type = typename future_value<T>::type;
+
+private:
+    enum : stdint::u8
+    {
+        PENDING,
+        CONTINUATION,
+        READY
+    };
+
+    atomic<stdint::u32> m_references;
+    atomic<stdint::u8> m_status;
+    std::optional<value_type> m_value;
+    std::exception_ptr m_error;
+    task m_continuation;
+
+public:
+    shared_state()
+        : m_references(1)
+        , m_status(PENDING)
+        , m_value()
+        , m_error()
+        , m_continuation()
+    {}
+
+    shared_state(const shared_state&) = delete;
+    shared_state& operator=(const shared_state&) = delete;
+
+    void retain()
+    {
+        m_references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release()
+    {
+        if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    bool is_ready() const
+    {
+        return m_status.load(std::memory_order_acquire) == READY;
+    }
+
+    template<typename... Args>
+    void set_value(Args&&... args)
+    {
+        m_value.emplace(std::forward<Args>(args)...);
+        _complete();
+    }
+
+    void set_exception(std::exception_ptr error)
+    {
+        m_error = std::move(error);
+        _complete();
+    }
+
+    /**
+     * @brief Run t once the state is ready, only one callback can be registered
+     */
+    void on_ready(task&& t)
+    {
+        m_continuation = std::move(t);
+
+        stdint::u8 expected = PENDING;
+        if (!m_status.compare_exchange_strong(expected, CONTINUATION, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            task ready = std::move(m_continuation);
+            ready();
+        }
+    }
+
+    // only once ready
+
+    bool has_error() const
+    {
+        return bool(m_error);
+    }
+
+    std::exception_ptr error() const
+    {
+        return m_error;
+    }
+
+    value_type take()
+    {
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+        return std::move(*m_value);
+    }
+
+private:
+    void _complete()
+    {
+        if (m_status.exchange(READY, std::memory_order_acq_rel) == CONTINUATION)
+        {
+            task continuation = std::move(m_continuation);
+            continuation();
+        }
+    }
+};
+
+/**
+ * @brief state_holder One reference to a shared_state, owned by a task posted to an executor
+ * @details An executor may destroy a task without running it (fixed_pool::shutdown(false) drops its queue):
+ *          the holder then breaks the promise of a state still pending and releases it, as promise does,
+ *          instead of leaving its future waiting forever.
+ */
+template<typename T>
+class state_holder
+{
+private:
+    shared_state<T>* m_state;
+
+public:
+    explicit state_holder(shared_state<T>* state) noexcept
+        : m_state(state)
+    {}
+
+    state_holder(state_holder&& other) noexcept
+        : m_state(other.m_state)
+    {
+        other.m_state = nullptr;
+    }
+
+    state_holder(const state_holder&) = delete;
+    state_holder& operator=(const state_holder&) = delete;
+    state_holder& operator=(state_holder&&) = delete;
+
+    ~state_holder()
+    {
+        if (m_state != nullptr)
+        {
+            if (!m_state->is_ready())
+            {
+                m_state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            }
+            m_state->release();
+        }
+    }
+
+    shared_state<T>* get() const noexcept
+    {
+        return m_state;
+    }
+
+    /**
+     * @brief Give the reference back once the task has run (the state is completed or will be by someone else)
+     */
+    void release() noexcept
+    {
+        m_state->release();
+        m_state = nullptr;
+    }
+};
+
+template<typename T>
+future<T> make_exceptional_future(std::exception_ptr error);
+
+// completes a state (fulfil) or builds a ready future (ready) with the result of g(), R being what g returns
+template<typename R>
+struct future_setter
+{
+    template<typename G>
+    static void fulfil(shared_state<R>* state, G&& g)
+    {
+        try
+        {
+            state->set_value(g());
+        }
+        catch (...)
+        {
+            state->set_exception(std::current_exception());
+        }
+    }
+
+    template<typename G>
+    static future<R> ready(G&& g)
+    {
+        try
+        {
+            return future<R>(std::in_place, g());
+        }
+        catch (...)
+        {
+            return make_exceptional_future<R>(std::current_exception());
+        }
+    }
+};
+
+template<>
+struct future_setter<void>
+{
+    template<typename G>
+    static void fulfil(shared_state<void>* state, G&& g)
+    {
+        try
+        {
+            g();
+            state->set_value();
+        }
+        catch (...)
+        {
+            state->set_exception(std::current_exception());
+        }
+    }
+
+    template<typename G>
+    static future<void> ready(G&& g);
+};
+
+template<typename U>
+struct future_setter<future<U>>
+{
+    template<typename G>
+    static void fulfil(shared_state<U>* state, G&& g)
+    {
+        try
+        {
+            g()._forward_to(state);
+        }
+        catch (...)
+        {
+            state->set_exception(std::current_exception());
+        }
+    }
+
+    template<typename G>
+    static future<U> ready(G&& g)
+    {
+        try
+        {
+            return g();
+        }
+        catch (...)
+        {
+            return make_exceptional_future<U>(std::current_exception());
+        }
+    }
+};
+
+/**
+ * @brief future The result of a task that may still be running
+ * @details Move only. A future made ready from the start (make_ready_future) holds its value inline, without
+ *          any allocation. then() chains a continuation that runs when the value is there, without blocking
+ *          a thread, get() and wait() block.
+ */
+template<typename T>
+class future
+{
+public:
+    using value_type = typename future_value<T>::type;
+
+    /**
+     * @brief The future returned by then(f)
+     */
+    template<typename F>
+    using then_type = future<typename future_unwrap<typename future_value<T>::template result<typename std::decay<F>::type>>::type>;
+
+private:
+    template<typename>
+    friend class future;
+
+    template<typename>
+    friend struct future_setter;
+
+    template<typename U>
+    friend future<std::vector<future<U>>> when_all(std::vector<future<U>> futures);
+
+    template<typename U>
+    friend future<when_any_result<U>> when_any(std::vector<future<U>> futures);
+
+    shared_state<T>* m_state;
+    std::optional<value_type> m_ready;
+
+public:
+    future() noexcept
+        : m_state(nullptr)
+        , m_ready()
+    {}
+
+    /**
+     * @brief Construct a future waiting for state (adopts one reference)
+     */
+    explicit future(shared_state<T>* state) noexcept
+        : m_state(state)
+        , m_ready()
+    {}
+
+    /**
+     * @brief Construct a ready future holding the value built from args
+     */
+    template<typename... Args>
+    explicit future(std::in_place_t, Args&&... args)
+        : m_state(nullptr)
+        , m_ready(std::in_place, std::forward<Args>(args)...)
+    {}
+
+    future(future&& other) noexcept
+        : m_state(other.m_state)
+        , m_ready(std::move(other.m_ready))
+    {
+        other.m_state = nullptr;
+        other.m_ready.reset();
+    }
+
+    future& operator=(future&& other) noexcept
+    {
+        if (this != &other)
+        {
+            _release();
+            m_state = other.m_state;
+            m_ready = std::move(other.m_ready);
+            other.m_state = nullptr;
+            other.m_ready.reset();
+        }
+        return *this;
+    }
+
+    future(const future&) = delete;
+    future& operator=(const future&) = delete;
+
+    ~future()
+    {
+        _release();
+    }
+
+    bool valid() const noexcept
+    {
+        return m_state != nullptr || m_ready.has_value();
+    }
+
+    bool is_ready() const
+    {
+        return m_ready.has_value() || (m_state != nullptr && m_state->is_ready());
+    }
+
+    /**
+     * @brief Block until the value (or the exception) is there
+     * @details Blocks the calling thread, prefer then() from inside a task
+     */
+    void wait() const
+    {
+        if (is_ready())
+        {
+            return;
+        }
+
+        struct waiter
+        {
+            thread_safe::mutex mutex;
+            condition_variable condition;
+            bool done = false;
+        } w;
+
+        m_state->on_ready(task([&w]() {
+            thread_safe::lock_guard lock(w.mutex);
+            w.done = true;
+            w.condition.notify_one();
+        }));
+
+        std::unique_lock<thread_safe::mutex> lock(w.mutex);
+        w.condition.wait(lock, [&w]() { return w.done; });
+    }
+
+    /**
+     * @brief Wait for the value and take it (the future becomes invalid), rethrows the exception of the task
+     */
+    T get()
+    {
+        wait();
+
+        if (m_ready)
+        {
+            value_type value = std::move(*m_ready);
+            m_ready.reset();
+            return future_value<T>::get(std::move(value));
+        }
+
+        shared_state<T>* state = m_state;
+        m_state = nullptr;
+
+        try
+        {
+            value_type value = state->take();
+            state->release();
+            return future_value<T>::get(std::move(value));
+        }
+        catch (...)
+        {
+            state->release();
+            throw;
+        }
+    }
+
+    /**
+     * @brief Run f(value) on ex once the value is there (the future becomes invalid)
+     * @details An exception is forwarded to the returned future without calling f, f runs inline when ex
+     *          does not accept tasks anymore. A continuation returning a future<U> gives a future<U>.
+     */
+    template<typename F>
+    then_type<F> then(executor& ex, F&& f)
+    {
+        return _then(&ex, std::forward<F>(f));
+    }
+
+    /**
+     * @brief Run f(value) in the thread that completes the future (or right away when it is ready)
+     */
+    template<typename F>
+    then_type<F> then(F&& f)
+    {
+        return _then(nullptr, std::forward<F>(f));
+    }
+
+private:
+    void _release()
+    {
+        if (m_state != nullptr)
+        {
+            m_state->release();
+            m_state = nullptr;
+        }
+        m_ready.reset();
+    }
+
+    template<typename F>
+    then_type<F> _then(executor* ex, F&& f)
+    {
+        using function_type = typename std::decay<F>::type;
+        using result_type = typename future_value<T>::template result<function_type>;
+        using next_type = typename future_unwrap<result_type>::type;
+
+        if (m_ready && ex == nullptr)
+        {
+            // nothing to wait for nor to schedule: no allocation
+            value_type value = std::move(*m_ready);
+            m_ready.reset();
+            return future_setter<result_type>::ready([&]() -> result_type {
+                return future_value<T>::invoke(f, std::move(value));
+            });
+        }
+
+        if (m_ready)
+        {
+            m_state = new shared_state<T>();
+            m_state->set_value(std::move(*m_ready));
+            m_ready.reset();
+        }
+
+        shared_state<T>* self = m_state;
+        shared_state<next_type>* next = new shared_state<next_type>();
+
+        m_state = nullptr;
+        next->retain(); // one for the continuation, one for the returned future
+
+        self->on_ready(task([self, next, ex, fn = function_type(std::forward<F>(f))]() mutable {
+            // held by the body so that a body dropped by the executor still breaks next and releases both
+            task body([source = state_holder<T>(self), target = state_holder<next_type>(next), fn = std::move(fn)]() mutable {
+                if (source.get()->has_error())
+                {
+                    target.get()->set_exception(source.get()->error());
+                }
+                else
+                {
+                    future_setter<result_type>::fulfil(target.get(), [&]() -> result_type {
+                        return future_value<T>::invoke(fn, source.get()->take());
+                    });
+                }
+                source.release();
+                target.release();
+            });
+
+            if (ex == nullptr || !ex->post(std::move(body)))
+            {
+                body();
+            }
+        }));
+
+        return future<next_type>(next);
+    }
+
+    // completes target with this future's outcome once it is there
+    void _forward_to(shared_state<T>* target)
+    {
+        if (m_ready)
+        {
+            target->set_value(std::move(*m_ready));
+            m_ready.reset();
+            return;
+        }
+
+        if (m_state == nullptr)
+        {
+            target->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::no_state)));
+            return;
+        }
+
+        shared_state<T>* source = m_state;
+
+        m_state = nullptr;
+        target->retain();
+        source->on_ready(task([source, target]() {
+            if (source->has_error())
+            {
+                target->set_exception(source->error());
+            }
+            else
+            {
+                target->set_value(source->take());
+            }
+            source->release();
+            target->release();
+        }));
+    }
+
+    // runs t once ready, without consuming the value
+    void _on_ready(task&& t)
+    {
+        if (m_state == nullptr)
+        {
+            t();
+            return;
+        }
+        m_state->on_ready(std::move(t));
+    }
+};
+
+template<typename G>
+future<void> future_setter<void>::ready(G&& g)
+{
+    try
+    {
+        g();
+        return future<void>(std::in_place);
+    }
+    catch (...)
+    {
+        return make_exceptional_future<void>(std::current_exception());
+    }
+}
+
+/**
+ * @brief promise The producer side of a future
+ * @details A promise destroyed before being satisfied gives std::future_errc::broken_promise to its future
+ */
+template<typename T>
+class promise
+{
+private:
+    shared_state<T>* m_state;
+    bool m_retrieved;
+    bool m_satisfied;
+
+public:
+    promise()
+        : m_state(new shared_state<T>())
+        , m_retrieved(false)
+        , m_satisfied(false)
+    {}
+
+    promise(promise&& other) noexcept
+        : m_state(other.m_state)
+        , m_retrieved(other.m_retrieved)
+        , m_satisfied(other.m_satisfied)
+    {
+        other.m_state = nullptr;
+    }
+
+    promise& operator=(promise&& other) noexcept
+    {
+        if (this != &other)
+        {
+            _abandon();
+            m_state = other.m_state;
+            m_retrieved = other.m_retrieved;
+            m_satisfied = other.m_satisfied;
+            other.m_state = nullptr;
+        }
+        return *this;
+    }
+
+    promise(const promise&) = delete;
+    promise& operator=(const promise&) = delete;
+
+    ~promise()
+    {
+        _abandon();
+    }
+
+    future<T> get_future()
+    {
+        if (m_state == nullptr)
+        {
+            throw std::future_error(std::future_errc::no_state);
+        }
+        if (m_retrieved)
+        {
+            throw std::future_error(std::future_errc::future_already_retrieved);
+        }
+
+        m_retrieved = true;
+        m_state->retain();
+        return future<T>(m_state);
+    }
+
+    template<typename... Args>
+    void set_value(Args&&... args)
+    {
+        _check();
+        m_satisfied = true;
+        m_state->set_value(std::forward<Args>(args)...);
+    }
+
+    void set_exception(std::exception_ptr error)
+    {
+        _check();
+        m_satisfied = true;
+        m_state->set_exception(std::move(error));
+    }
+
+private:
+    void _check() const
+    {
+        if (m_state == nullptr)
+        {
+            throw std::future_error(std::future_errc::no_state);
+        }
+        if (m_satisfied)
+        {
+            throw std::future_error(std::future_errc::promise_already_satisfied);
+        }
+    }
+
+    void _abandon()
+    {
+        if (m_state == nullptr)
+        {
+            return;
+        }
+
+        if (!m_satisfied)
+        {
+            m_state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        }
+        m_state->release();
+        m_state = nullptr;
+    }
+};
+
+template<typename T>
+future<typename std::decay<T>::type> make_ready_future(T&& value)
+{
+    return future<typename std::decay<T>::type>(std::in_place, std::forward<T>(value));
+}
+
+inline future<void> make_ready_future()
+{
+    return future<void>(std::in_place);
+}
+
+template<typename T>
+future<T> make_exceptional_future(std::exception_ptr error)
+{
+    shared_state<T>* state = new shared_state<T>();
+
+    state->set_exception(std::move(error));
+    return future<T>(state);
+}
+
+/**
+ * @brief A future ready once all the futures are, holding them (each one ready, with its value or exception)
+ */
+template<typename T>
+future<std::vector<future<T>>> when_all(std::vector<future<T>> futures)
+{
+    struct all_state
+    {
+        std::vector<future<T>> futures;
+        atomic_size_t remaining;
+        promise<std::vector<future<T>>> result;
+    };
+
+    all_state* all = new all_state { std::move(futures), {}, {} };
+    future<std::vector<future<T>>> result = all->result.get_future();
+
+    // one more than the futures, so the last arrival cannot happen while registering
+    all->remaining.store(all->futures.size() + 1, std::memory_order_relaxed);
+
+    auto arrive = [all]() {
+        if (all->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            all->result.set_value(std::move(all->futures));
+            delete all;
+        }
+    };
+
+    for (future<T>& f : all->futures)
+    {
+        f._on_ready(task(arrive));
+    }
+    arrive();
+
+    return result;
+}
+
+/**
+ * @brief Result of when_any: the index of the first future ready and that future
+ */
+template<typename T>
+struct when_any_result
+{
+    std::size_t index;
+    future<T> result;
+};
+
+/**
+ * @brief A future ready as soon as one of the futures is, the others are dropped
+ * @details An empty vector gives a ready result holding an invalid future
+ */
+template<typename T>
+future<when_any_result<T>> when_any(std::vector<future<T>> futures)
+{
+    if (futures.empty())
+    {
+        return make_ready_future(when_any_result<T> { 0, future<T>() });
+    }
+
+    struct any_state
+    {
+        std::vector<future<T>> futures;
+        atomic_size_t remaining;
+        atomic_bool done;
+        promise<when_any_result<T>> result;
+    };
+
+    any_state* any = new any_state { std::move(futures), {}, {}, {} };
+    future<when_any_result<T>> result = any->result.get_future();
+
+    // the state lives until every future has completed, their callbacks point to it
+    any->remaining.store(any->futures.size() + 1, std::memory_order_relaxed);
+    any->done.store(false, std::memory_order_relaxed);
+
+    auto arrive = [any]() {
+        if (any->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete any;
+        }
+    };
+
+    for (std::size_t i = 0; i < any->futures.size(); i++)
+    {
+        any->futures[i]._on_ready(task([any, i, arrive]() {
+            if (!any->done.exchange(true, std::memory_order_acq_rel))
+            {
+                any->result.set_value(when_any_result<T> { i, std::move(any->futures[i]) });
+            }
+            arrive();
+        }));
+    }
+    arrive();
+
+    return result;
+}
+
+template<typename F>
+auto executor::submit(F&& f)
+{
+    using function_type = typename std::decay<F>::type;
+    using result_type = decltype(std::declval<function_type&>()());
+    using value_type = typename future_unwrap<result_type>::type;
+
+    shared_state<value_type>* state = new shared_state<value_type>();
+    future<value_type> result(state);
+
+    state->retain(); // for the task
+    task t([holder = state_holder<value_type>(state), fn = function_type(std::forward<F>(f))]() mutable {
+        future_setter<result_type>::fulfil(holder.get(), fn);
+        holder.release();
+    });
+
+    // a task refused (left in t) or dropped by the executor without running breaks the promise when destroyed
+    post(std::move(t));
+    return result;
+}
+
+}
+}
+}
+}
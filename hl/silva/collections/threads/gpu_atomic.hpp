@@ -0,0 +1,140 @@
+/**
+ * hl/silva/collections/threads/gpu_atomic.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+
+#include <type_traits>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+// integers use the fetch_ instructions, the others a compare and swap loop
+template<typename T>
+T _atomic_add(atomic<T>& target, T value, std::memory_order order, std::true_type)
+{
+    return target.fetch_add(value, order);
+}
+
+template<typename T>
+T _atomic_add(atomic<T>& target, T value, std::memory_order order, std::false_type)
+{
+    T current = target.load(std::memory_order_relaxed);
+
+    while (!target.compare_exchange_weak(current, T(current + value), order, std::memory_order_relaxed))
+    {
+    }
+    return current;
+}
+
+template<typename T>
+T _atomic_sub(atomic<T>& target, T value, std::memory_order order, std::true_type)
+{
+    return target.fetch_sub(value, order);
+}
+
+template<typename T>
+T _atomic_sub(atomic<T>& target, T value, std::memory_order order, std::false_type)
+{
+    T current = target.load(std::memory_order_relaxed);
+
+    while (!target.compare_exchange_weak(current, T(current - value), order, std::memory_order_relaxed))
+    {
+    }
+    return current;
+}
+
+/**
+ * @brief Atomic helpers of gpu_sim kernels, named after their CUDA counterparts (atomicAdd, atomicMin...)
+ * @details They return the previous value and default to relaxed ordering like CUDA. Integers use the fetch_
+ *          instructions, floating point values (no fetch_add before C++20) and min / max a compare and swap loop.
+ *          Prefer block.reduce or gpu_sim::reduce to many atomics on one value: one cache line bouncing between
+ *          every core does not scale.
+ */
+template<typename T>
+T atomic_add(atomic<T>& target, typename atomic<T>::value_type value, std::memory_order order = std::memory_order_relaxed)
+{
+    return _atomic_add(target, value, order, std::is_integral<T>());
+}
+
+template<typename T>
+T atomic_sub(atomic<T>& target, typename atomic<T>::value_type value, std::memory_order order = std::memory_order_relaxed)
+{
+    return _atomic_sub(target, value, order, std::is_integral<T>());
+}
+
+/**
+ * @brief Stores value when it is smaller than the current one, does not write when it is not
+ */
+template<typename T>
+T atomic_min(atomic<T>& target, typename atomic<T>::value_type value, std::memory_order order = std::memory_order_relaxed)
+{
+    T current = target.load(std::memory_order_relaxed);
+
+    while (value < current && !target.compare_exchange_weak(current, value, order, std::memory_order_relaxed))
+    {
+    }
+    return current;
+}
+
+/**
+ * @brief Stores value when it is bigger than the current one, does not write when it is not
+ */
+template<typename T>
+T atomic_max(atomic<T>& target, typename atomic<T>::value_type value, std::memory_order order = std::memory_order_relaxed)
+{
+    T current = target.load(std::memory_order_relaxed);
+
+    while (current < value && !target.compare_exchange_weak(current, value, order, std::memory_order_relaxed))
+    {
+    }
+    return current;
+}
+
+template<typename T>
+T atomic_exch(atomic<T>& target, typename atomic<T>::value_type value, std::memory_order order = std::memory_order_relaxed)
+{
+    return target.exchange(value, order);
+}
+
+/**
+ * @brief Stores value when the current value is expected, returns the current value either way (atomicCAS)
+ */
+template<typename T>
+T atomic_cas(atomic<T>& target, typename atomic<T>::value_type expected, typename atomic<T>::value_type value, std::memory_order order = std::memory_order_relaxed)
+{
+    target.compare_exchange_strong(expected, value, order, std::memory_order_relaxed);
+    return expected;
+}
+
+}
+}
+}
+}
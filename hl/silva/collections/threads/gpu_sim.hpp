@@ -24,6 +24,35 @@
 #pragma once
 
 #include <hl/silva/collections/threads/basic_pool_async.hpp>
+#include <hl/silva/collections/threads/device_arena.hpp>
+#include <hl/silva/collections/threads/fixed_pool.hpp>
+#include <hl/silva/collections/threads/parallel.hpp>
+#include <hl/silva/collections/threads/gpu_atomic.hpp>
+#include <hl/silva/collections/threads/lane_vector.hpp>
+#include <hl/silva/collections/threads/stream.hpp>
+#include <hl/silva/collections/threads/traversal.hpp>
+
+#include <new>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+// Default lane count of launch_lanes (8 float lanes fill an AVX2 register, use 16 for AVX-512)
+#ifndef SILVA_THREADS_GPU_SIM_LANES
+#define SILVA_THREADS_GPU_SIM_LANES 8
+#endif
+
+// start / start_fmt cut the x dimension in rows of this many indexes, each row is a plain loop on one worker
+#ifndef SILVA_THREADS_GPU_SIM_ROW_SIZE
+#define SILVA_THREADS_GPU_SIM_ROW_SIZE 1024
+#endif
+
+// memcpy / memset cut their range in chunks of this many bytes spread over the workers
+#ifndef SILVA_THREADS_GPU_SIM_COPY_GRAIN
+#define SILVA_THREADS_GPU_SIM_COPY_GRAIN (std::size_t(256) << 10)
+#endif
 
 namespace hl
 {
@@ -159,59 +188,852 @@ public:
     static inline HL_CONSTEXPR thread_index ZXY(const thread_index& index) { return thread_index(index.z, index.x, index.y); };
     static inline HL_CONSTEXPR thread_index ZYX(const thread_index& index) { return thread_index(index.z, index.y, index.x); };
 
+    /**
+     * @brief index_swizzle Stateless index format, the counterpart of XYZ ... ZYX that the compiler can inline
+     * @tparam X, Y, Z The component (0 for x, 1 for y, 2 for z) of the index each component of the result comes from
+     */
+    template<unsigned int X, unsigned int Y, unsigned int Z>
+    struct index_swizzle {
+        static HL_CONSTEXPR unsigned int component(const thread_index& index, unsigned int c)
+        {
+            return c == 0 ? index.x : (c == 1 ? index.y : index.z);
+        }
+
+        HL_CONSTEXPR thread_index operator()(const thread_index& index) const
+        {
+            return thread_index(component(index, X), component(index, Y), component(index, Z));
+        }
+    };
+
+    using swizzle_xyz = index_swizzle<0, 1, 2>;
+    using swizzle_xzy = index_swizzle<0, 2, 1>;
+    using swizzle_yxz = index_swizzle<1, 0, 2>;
+    using swizzle_yzx = index_swizzle<1, 2, 0>;
+    using swizzle_zxy = index_swizzle<2, 0, 1>;
+    using swizzle_zyx = index_swizzle<2, 1, 0>;
+
+    /**
+     * @brief launch_context What a kernel knows about the index it runs for (gridDim, blockDim, blockIdx and threadIdx in CUDA)
+     */
+    struct launch_context {
+        thread_index grid_dim;
+        thread_index block_dim;
+        thread_index block_index;
+        thread_index local_index;
+
+        HL_CONSTEXPR thread_index global_index(void) const
+        {
+            return thread_index(
+                block_index.x * block_dim.x + local_index.x,
+                block_index.y * block_dim.y + local_index.y,
+                block_index.z * block_dim.z + local_index.z);
+        }
+
+        HL_CONSTEXPR thread_index global_size(void) const
+        {
+            return thread_index(grid_dim.x * block_dim.x, grid_dim.y * block_dim.y, grid_dim.z * block_dim.z);
+        }
+
+        /**
+         * @brief local_linear The index of the thread in its block, x first (to index per thread shared memory)
+         */
+        HL_CONSTEXPR std::size_t local_linear(void) const
+        {
+            return (std::size_t(local_index.z) * block_dim.y + local_index.y) * block_dim.x + local_index.x;
+        }
+    };
+
+    /**
+     * @brief block_context What a block kernel gets: the shared memory of the block and its threads
+     * @details The threads of a block run as phases: threads(phase) calls phase for every thread of the block in
+     *          turn (x first), on the worker running the block. A phase only starts once the previous one is done
+     *          for every thread, so returning from threads() is the barrier (__syncthreads) and costs nothing.
+     *          Locals of a phase do not survive the barrier, keep what the next phase needs in shared memory.
+     */
+    class block_context {
+    private:
+        launch_context _context;
+        unsigned char* _shared;
+        std::size_t _shared_size;
+        std::size_t _shared_used;
+
+    public:
+        block_context(const thread_index& grid, const thread_index& block, const thread_index& block_index,
+            unsigned char* shared, std::size_t shared_size)
+            : _context()
+            , _shared(shared)
+            , _shared_size(shared_size)
+            , _shared_used(0)
+        {
+            _context.grid_dim = grid;
+            _context.block_dim = block;
+            _context.block_index = block_index;
+        }
+
+        const thread_index& grid_dim(void) const
+        {
+            return _context.grid_dim;
+        }
+
+        const thread_index& block_dim(void) const
+        {
+            return _context.block_dim;
+        }
+
+        const thread_index& block_index(void) const
+        {
+            return _context.block_index;
+        }
+
+        /**
+         * @brief size The number of threads in the block
+         */
+        std::size_t size(void) const
+        {
+            return std::size_t(_context.block_dim.x) * _context.block_dim.y * _context.block_dim.z;
+        }
+
+        /**
+         * @brief shared Allocates count uninitialized T in the shared memory of the block
+         * @details Throws std::length_error past the shared_bytes given to launch, the allocations of a block are
+         *          released when it ends
+         */
+        template<typename T>
+        T* shared(std::size_t count = 1)
+        {
+            static_assert(std::is_trivially_default_constructible<T>::value && std::is_trivially_destructible<T>::value,
+                "gpu_sim shared memory holds trivial types");
+            static_assert(alignof(T) <= SILVA_THREADS_CACHE_LINE_SIZE, "gpu_sim shared memory alignment is a cache line");
+
+            const std::size_t offset = (_shared_used + alignof(T) - 1) / alignof(T) * alignof(T);
+
+            if (offset > _shared_size || count > (_shared_size - offset) / sizeof(T))
+            {
+                throw std::length_error("gpu_sim: shared memory exhausted");
+            }
+            _shared_used = offset + count * sizeof(T);
+
+            T* values = reinterpret_cast<T*>(_shared + offset);
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                ::new (static_cast<void*>(values + i)) T;
+            }
+            return values;
+        }
+
+        /**
+         * @brief shared_size The shared memory of the block, in bytes
+         */
+        std::size_t shared_size(void) const
+        {
+            return _shared_size;
+        }
+
+        /**
+         * @brief threads Runs phase for every thread of the block, then returns (barrier)
+         * @tparam Order The order the threads run in (linear_order, tiled_order or morton_order)
+         * @param phase void(const launch_context&)
+         */
+        template<typename Order = linear_order, typename Phase>
+        void threads(Phase&& phase)
+        {
+            Order::for_each(_context.block_dim, [&](const thread_index& local) {
+                _context.local_index = local;
+                phase(static_cast<const launch_context&>(_context));
+            });
+        }
+
+        /**
+         * @brief reduce Folds value(context) of every thread of the block with combine, as a phase (BlockReduce)
+         * @param value T(const launch_context&)
+         * @param combine T(T, T), associative
+         * @details The threads of a block run on one worker, so this is a plain loop: no tree, no barrier
+         */
+        template<typename T, typename Value, typename Combine>
+        T reduce(T identity, Value&& value, Combine&& combine)
+        {
+            T result = std::move(identity);
+
+            threads([&](const launch_context& context) {
+                result = combine(std::move(result), value(context));
+            });
+            return result;
+        }
+
+        /**
+         * @brief inclusive_scan Replaces values[i] (one per thread, by local_linear) by values[0] combined up to values[i]
+         * @return the combination of all the values
+         */
+        template<typename T, typename Combine>
+        T inclusive_scan(T* values, Combine&& combine) const
+        {
+            const std::size_t count = size();
+
+            for (std::size_t i = 1; i < count; i++)
+            {
+                values[i] = combine(values[i - 1], values[i]);
+            }
+            return values[count - 1];
+        }
+
+        /**
+         * @brief exclusive_scan Replaces values[i] (one per thread, by local_linear) by identity combined with
+         *        values[0] up to values[i - 1] (BlockScan)
+         * @return the combination of all the values, the total a block usually publishes
+         */
+        template<typename T, typename Combine>
+        T exclusive_scan(T* values, T identity, Combine&& combine) const
+        {
+            const std::size_t count = size();
+            T running = std::move(identity);
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                T current = std::move(values[i]);
+
+                values[i] = running;
+                running = combine(std::move(running), std::move(current));
+            }
+            return running;
+        }
+    };
+
+    /**
+     * @brief lane_context What a lane kernel knows: a warp of Lanes adjacent x indexes of a block, run at once
+     * @details local_index is the index of lane 0, lane i has local_index.x + i. At the end of a row of the block
+     *          (block.x not a multiple of Lanes) the lanes past it are inactive: they are cleared from mask, loads
+     *          give them T() and stores skip them.
+     */
+    template<std::size_t Lanes>
+    struct lane_context {
+        thread_index grid_dim;
+        thread_index block_dim;
+        thread_index block_index;
+        thread_index local_index;
+        lane_mask mask;
+
+        HL_INLINE_CONSTEXPR_VARIABLE lane_mask full_mask = Lanes == 64 ? ~lane_mask(0) : (lane_mask(1) << Lanes) - 1;
+
+        static constexpr std::size_t lanes(void)
+        {
+            return Lanes;
+        }
+
+        /**
+         * @brief global_index The global index of lane 0
+         */
+        HL_CONSTEXPR thread_index global_index(void) const
+        {
+            return thread_index(
+                block_index.x * block_dim.x + local_index.x,
+                block_index.y * block_dim.y + local_index.y,
+                block_index.z * block_dim.z + local_index.z);
+        }
+
+        HL_CONSTEXPR thread_index global_size(void) const
+        {
+            return thread_index(grid_dim.x * block_dim.x, grid_dim.y * block_dim.y, grid_dim.z * block_dim.z);
+        }
+
+        /**
+         * @brief global_x The global x index of every lane
+         */
+        lane_vector<unsigned int, Lanes> global_x(void) const
+        {
+            const unsigned int first = block_index.x * block_dim.x + local_index.x;
+            lane_vector<unsigned int, Lanes> x;
+
+            for (std::size_t lane = 0; lane < Lanes; lane++)
+            {
+                x.values[lane] = first + (unsigned int)lane;
+            }
+            return x;
+        }
+
+        bool active(std::size_t lane) const
+        {
+            return (mask >> lane) & 1;
+        }
+
+        /**
+         * @brief load Reads first[0] ... first[Lanes - 1] (first being the element of lane 0), T() for inactive lanes
+         */
+        template<typename T>
+        lane_vector<T, Lanes> load(const T* first) const
+        {
+            lane_vector<T, Lanes> values;
+
+            if (mask == full_mask)
+            {
+                for (std::size_t lane = 0; lane < Lanes; lane++)
+                {
+                    values.values[lane] = first[lane];
+                }
+            }
+            else
+            {
+                for (std::size_t lane = 0; lane < Lanes; lane++)
+                {
+                    values.values[lane] = active(lane) ? first[lane] : T();
+                }
+            }
+            return values;
+        }
+
+        /**
+         * @brief store Writes the active lanes of values to first[0] ... first[Lanes - 1]
+         */
+        template<typename T>
+        void store(T* first, const lane_vector<T, Lanes>& values) const
+        {
+            store(first, values, full_mask);
+        }
+
+        /**
+         * @brief store Writes the lanes of values both active and set in only (a lane masked store)
+         */
+        template<typename T>
+        void store(T* first, const lane_vector<T, Lanes>& values, lane_mask only) const
+        {
+            const lane_mask lanes = mask & only;
+
+            if (lanes == full_mask)
+            {
+                for (std::size_t lane = 0; lane < Lanes; lane++)
+                {
+                    first[lane] = values.values[lane];
+                }
+            }
+            else
+            {
+                for (std::size_t lane = 0; lane < Lanes; lane++)
+                {
+                    if ((lanes >> lane) & 1)
+                    {
+                        first[lane] = values.values[lane];
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief ballot The active lanes where predicate is true (__ballot_sync)
+         */
+        lane_mask ballot(const lane_vector<bool, Lanes>& predicate) const
+        {
+            return to_mask(predicate) & mask;
+        }
+
+        bool any(const lane_vector<bool, Lanes>& predicate) const
+        {
+            return ballot(predicate) != 0;
+        }
+
+        bool all(const lane_vector<bool, Lanes>& predicate) const
+        {
+            return ballot(predicate) == mask;
+        }
+    };
+
 private:
-    basic_pool_async _pool;
+    /**
+     * @brief shared_arena Per thread bump allocator backing the shared memory of the blocks it runs
+     * @details Grows to the biggest shared_bytes seen and is then reused by every block, so a launch does not
+     *          allocate. A region requested while the arena is in use and too small (a launch from a block kernel)
+     *          gets its own buffer.
+     */
+    class shared_arena {
+    private:
+        std::unique_ptr<unsigned char[]> _buffer;
+        unsigned char* _base;
+        std::size_t _capacity;
+        std::size_t _used;
+
+    public:
+        shared_arena()
+            : _buffer()
+            , _base(nullptr)
+            , _capacity(0)
+            , _used(0)
+        {}
+
+        static shared_arena& local(void)
+        {
+            static thread_local shared_arena arena;
+            return arena;
+        }
+
+        std::size_t used(void) const
+        {
+            return _used;
+        }
+
+        // a cache line aligned region of size bytes, or nullptr when it does not fit while in use
+        unsigned char* acquire(std::size_t size)
+        {
+            size = (size + SILVA_THREADS_CACHE_LINE_SIZE - 1) / SILVA_THREADS_CACHE_LINE_SIZE * SILVA_THREADS_CACHE_LINE_SIZE;
+
+            if (_capacity - _used < size)
+            {
+                if (_used != 0)
+                {
+                    return nullptr;
+                }
+                _buffer.reset(new unsigned char[size + SILVA_THREADS_CACHE_LINE_SIZE]);
+                _base = _align(_buffer.get());
+                _capacity = size;
+            }
+
+            unsigned char* region = _base + _used;
+
+            _used += size;
+            return region;
+        }
+
+        void release(std::size_t used)
+        {
+            _used = used;
+        }
+
+        static unsigned char* _align(unsigned char* pointer)
+        {
+            const std::size_t misalignment = reinterpret_cast<std::uintptr_t>(pointer) % SILVA_THREADS_CACHE_LINE_SIZE;
+
+            return misalignment == 0 ? pointer : pointer + (SILVA_THREADS_CACHE_LINE_SIZE - misalignment);
+        }
+    };
+
+    /**
+     * @brief shared_region The shared memory of the blocks of a chunk, given back to the arena at the end
+     */
+    class shared_region {
+    private:
+        shared_arena& _arena;
+        std::size_t _mark;
+        std::unique_ptr<unsigned char[]> _own;
+        unsigned char* _memory;
+
+    public:
+        shared_region(std::size_t size)
+            : _arena(shared_arena::local())
+            , _mark(_arena.used())
+            , _own()
+            , _memory(size == 0 ? nullptr : _arena.acquire(size))
+        {
+            if (size != 0 && _memory == nullptr)
+            {
+                _own.reset(new unsigned char[size + SILVA_THREADS_CACHE_LINE_SIZE]);
+                _memory = shared_arena::_align(_own.get());
+            }
+        }
+
+        shared_region(const shared_region&) = delete;
+        shared_region& operator=(const shared_region&) = delete;
+
+        ~shared_region()
+        {
+            _arena.release(_mark);
+        }
+
+        unsigned char* memory(void) const
+        {
+            return _memory;
+        }
+    };
+
+    fixed_pool _workers;
+    device_arena _memory;
 
 public:
     /**
      * @brief GPUThreadSim
-     * @param thread_count The number of threads that can be used concurrently
+     * @param thread_count The number of threads that can be used concurrently (0 means one per hardware thread)
      */
-    gpu_sim()
-        : _pool()
+    gpu_sim(std::size_t thread_count = 0)
+        : _workers(thread_count)
+        , _memory(_workers)
     {}
 
+    /**
+     * @brief launch Runs kernel for every index of a grid of blocks and waits for it
+     * @param grid The number of blocks in each dimension
+     * @param block The number of indexes in a block in each dimension
+     * @param kernel void(const launch_context&)
+     * @tparam BlockOrder The order the blocks are handed out in: consecutive blocks of the order run on the same
+     *         worker, one after the other (linear_order, tiled_order or morton_order, see traversal.hpp)
+     * @tparam ThreadOrder The order the indexes of a block run in
+     * @details A block always runs on one worker, as a loop over its indexes (x first by default), the blocks are
+     *          spread over the persistent workers in chunks, so a launch costs a few task dispatches whatever its size.
+     */
+    template<typename BlockOrder = linear_order, typename ThreadOrder = linear_order, typename Kernel>
+    void launch(const thread_index& grid, const thread_index& block, Kernel&& kernel)
+    {
+        if (block.x == 0 || block.y == 0 || block.z == 0)
+        {
+            return;
+        }
+
+        _for_each_chunk<BlockOrder>(grid, [&](const blocked_range<std::size_t>& chunk) {
+            launch_context context;
+
+            context.grid_dim = grid;
+            context.block_dim = block;
+
+            for (std::size_t position = chunk.begin(); position != chunk.end(); position++)
+            {
+                if (!BlockOrder::at(grid, position, context.block_index))
+                {
+                    continue;
+                }
+
+                ThreadOrder::for_each(block, [&](const thread_index& local) {
+                    context.local_index = local;
+                    kernel(static_cast<const launch_context&>(context));
+                });
+            }
+        });
+    }
+
+    /**
+     * @brief launch Runs block_kernel once for every block of a grid, with shared_bytes of shared memory, and waits for it
+     * @param grid The number of blocks in each dimension
+     * @param block The number of threads in a block in each dimension
+     * @param shared_bytes The shared memory of a block (__shared__ in CUDA), in bytes
+     * @param block_kernel void(block_context&), allocates its shared memory with shared<T>() and runs the threads
+     *        of the block in phases with threads(), a barrier separating two phases
+     * @tparam BlockOrder The order the blocks are handed out in, see launch
+     * @details The shared memory comes from an arena of the worker, reused from block to block
+     */
+    template<typename BlockOrder = linear_order, typename BlockKernel>
+    void launch(const thread_index& grid, const thread_index& block, std::size_t shared_bytes, BlockKernel&& block_kernel)
+    {
+        if (block.x == 0 || block.y == 0 || block.z == 0)
+        {
+            return;
+        }
+
+        _for_each_chunk<BlockOrder>(grid, [&](const blocked_range<std::size_t>& chunk) {
+            shared_region shared(shared_bytes);
+            thread_index block_index;
+
+            for (std::size_t position = chunk.begin(); position != chunk.end(); position++)
+            {
+                if (!BlockOrder::at(grid, position, block_index))
+                {
+                    continue;
+                }
+
+                block_context context(grid, block, block_index, shared.memory(), shared_bytes);
+
+                block_kernel(context);
+            }
+        });
+    }
+
+    /**
+     * @brief launch_lanes Runs kernel for every warp of Lanes adjacent x indexes of a grid of blocks and waits for it
+     * @tparam Lanes The lanes of a warp, a power of two up to 64
+     * @param kernel void(const lane_context<Lanes>&), works on lane_vector values with the loads, stores, ballot
+     *        of the context and the shuffles of lane_vector.hpp
+     * @tparam BlockOrder The order the blocks are handed out in, see launch
+     * @details Same scheduling as launch, the rows of a block are cut in warps, the last one of a row masked
+     */
+    template<std::size_t Lanes = SILVA_THREADS_GPU_SIM_LANES, typename BlockOrder = linear_order, typename Kernel>
+    void launch_lanes(const thread_index& grid, const thread_index& block, Kernel&& kernel)
+    {
+        static_assert(Lanes != 0 && (Lanes & (Lanes - 1)) == 0 && Lanes <= 64, "gpu_sim lanes must be a power of two up to 64");
+
+        if (block.x == 0 || block.y == 0 || block.z == 0)
+        {
+            return;
+        }
+
+        _for_each_chunk<BlockOrder>(grid, [&](const blocked_range<std::size_t>& chunk) {
+            lane_context<Lanes> context;
+
+            context.grid_dim = grid;
+            context.block_dim = block;
+
+            for (std::size_t position = chunk.begin(); position != chunk.end(); position++)
+            {
+                if (!BlockOrder::at(grid, position, context.block_index))
+                {
+                    continue;
+                }
+
+                for (unsigned int z = 0; z < block.z; z++)
+                {
+                    for (unsigned int y = 0; y < block.y; y++)
+                    {
+                        unsigned int x = 0;
+
+                        // full warps first: the mask is known there, so the masked paths of the context fold away
+                        for (; block.x - x >= Lanes; x += (unsigned int)Lanes)
+                        {
+                            context.local_index = thread_index(x, y, z);
+                            context.mask = lane_context<Lanes>::full_mask;
+                            kernel(static_cast<const lane_context<Lanes>&>(context));
+                        }
+
+                        if (x != block.x)
+                        {
+                            context.local_index = thread_index(x, y, z);
+                            context.mask = (lane_mask(1) << (block.x - x)) - 1;
+                            kernel(static_cast<const lane_context<Lanes>&>(context));
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief reduce Folds value(context) of every index of a grid of blocks with combine and returns the result
+     * @param identity The neutral element of combine (every worker starts from it)
+     * @param value T(const launch_context&)
+     * @param combine T(T, T), associative
+     * @tparam BlockOrder, ThreadOrder The traversal orders, see launch
+     * @details Hierarchical: every worker folds the blocks it runs into its own cache line padded accumulator,
+     *          the accumulators are combined once at the end, so nothing is shared while the kernel runs
+     */
+    template<typename BlockOrder = linear_order, typename ThreadOrder = linear_order, typename T, typename Value, typename Combine>
+    T reduce(const thread_index& grid, const thread_index& block, T identity, Value&& value, Combine&& combine)
+    {
+        const std::size_t positions = BlockOrder::count(grid);
+
+        if (positions == 0 || block.x == 0 || block.y == 0 || block.z == 0)
+        {
+            return identity;
+        }
+
+        return parallel_reduce(_workers, blocked_range<std::size_t>(0, positions), identity,
+            [&](const blocked_range<std::size_t>& chunk, T accumulator) {
+                launch_context context;
+
+                context.grid_dim = grid;
+                context.block_dim = block;
+
+                for (std::size_t position = chunk.begin(); position != chunk.end(); position++)
+                {
+                    if (!BlockOrder::at(grid, position, context.block_index))
+                    {
+                        continue;
+                    }
+
+                    ThreadOrder::for_each(block, [&](const thread_index& local) {
+                        context.local_index = local;
+                        accumulator = combine(std::move(accumulator), value(static_cast<const launch_context&>(context)));
+                    });
+                }
+                return accumulator;
+            },
+            combine);
+    }
+
+    /**
+     * @brief launch Queues launch(grid, block, kernel) on s and returns right away
+     * @details The kernel is copied (or moved) into the queue, what it references must live until the stream ran it
+     */
+    template<typename BlockOrder = linear_order, typename ThreadOrder = linear_order, typename Kernel>
+    void launch(stream& s, const thread_index& grid, const thread_index& block, Kernel&& kernel)
+    {
+        s.post([this, grid, block, k = typename std::decay<Kernel>::type(std::forward<Kernel>(kernel))]() mutable {
+            launch<BlockOrder, ThreadOrder>(grid, block, k);
+        });
+    }
+
+    /**
+     * @brief launch Queues launch(grid, block, shared_bytes, block_kernel) on s and returns right away
+     */
+    template<typename BlockOrder = linear_order, typename BlockKernel>
+    void launch(stream& s, const thread_index& grid, const thread_index& block, std::size_t shared_bytes, BlockKernel&& block_kernel)
+    {
+        s.post([this, grid, block, shared_bytes, k = typename std::decay<BlockKernel>::type(std::forward<BlockKernel>(block_kernel))]() mutable {
+            launch<BlockOrder>(grid, block, shared_bytes, k);
+        });
+    }
+
+    /**
+     * @brief launch_lanes Queues launch_lanes<Lanes>(grid, block, kernel) on s and returns right away
+     */
+    template<std::size_t Lanes = SILVA_THREADS_GPU_SIM_LANES, typename BlockOrder = linear_order, typename Kernel>
+    void launch_lanes(stream& s, const thread_index& grid, const thread_index& block, Kernel&& kernel)
+    {
+        s.post([this, grid, block, k = typename std::decay<Kernel>::type(std::forward<Kernel>(kernel))]() mutable {
+            launch_lanes<Lanes, BlockOrder>(grid, block, k);
+        });
+    }
+
+    /**
+     * @brief synchronize Waits for everything queued on s, rethrows the first exception of its kernels
+     */
+    void synchronize(stream& s)
+    {
+        s.synchronize();
+    }
+
+    /**
+     * @brief device_malloc Allocates bytes of emulated device memory (cudaMalloc), a pointer bump in the arena
+     * @param alignment A power of two, 256 by default like cudaMalloc
+     */
+    void* device_malloc(std::size_t bytes, std::size_t alignment = SILVA_THREADS_DEVICE_ARENA_ALIGNMENT)
+    {
+        return _memory.allocate(bytes, alignment);
+    }
+
+    /**
+     * @brief device_malloc Allocates count uninitialized T of emulated device memory
+     */
+    template<typename T>
+    T* device_malloc(std::size_t count)
+    {
+        return _memory.allocate_array<T>(count);
+    }
+
+    /**
+     * @brief device_free Does nothing (cudaFree), the device memory comes back with memory().reset()
+     */
+    void device_free(void* pointer)
+    {
+        _memory.free(pointer);
+    }
+
+    /**
+     * @brief memory The arena of the device memory
+     */
+    device_arena& memory(void)
+    {
+        return _memory;
+    }
+
+    /**
+     * @brief memcpy Copies bytes from src to dst (not overlapping) on the workers, in parallel, and waits for it
+     */
+    void memcpy(void* dst, const void* src, std::size_t bytes)
+    {
+        unsigned char* to = static_cast<unsigned char*>(dst);
+        const unsigned char* from = static_cast<const unsigned char*>(src);
+
+        parallel_for(_workers, blocked_range<std::size_t>(0, bytes, SILVA_THREADS_GPU_SIM_COPY_GRAIN),
+            [to, from](const blocked_range<std::size_t>& chunk) {
+                std::memcpy(to + chunk.begin(), from + chunk.begin(), chunk.size());
+            });
+    }
+
+    /**
+     * @brief memset Sets bytes of dst to value on the workers, in parallel, and waits for it
+     */
+    void memset(void* dst, int value, std::size_t bytes)
+    {
+        unsigned char* to = static_cast<unsigned char*>(dst);
+
+        parallel_for(_workers, blocked_range<std::size_t>(0, bytes, SILVA_THREADS_GPU_SIM_COPY_GRAIN),
+            [to, value](const blocked_range<std::size_t>& chunk) {
+                std::memset(to + chunk.begin(), value, chunk.size());
+            });
+    }
+
+    /**
+     * @brief memcpy_async Queues memcpy(dst, src, bytes) on s and returns right away (cudaMemcpyAsync)
+     * @details The copy runs in order with the other work of s and overlaps with the other streams, src and dst
+     *          must stay valid until it ran (record an event after it to know when)
+     */
+    void memcpy_async(stream& s, void* dst, const void* src, std::size_t bytes)
+    {
+        s.post([this, dst, src, bytes]() { memcpy(dst, src, bytes); });
+    }
+
+    /**
+     * @brief memset_async Queues memset(dst, value, bytes) on s and returns right away (cudaMemsetAsync)
+     */
+    void memset_async(stream& s, void* dst, int value, std::size_t bytes)
+    {
+        s.post([this, dst, value, bytes]() { memset(dst, value, bytes); });
+    }
+
+    /**
+     * @brief workers The executor running the kernels, to create the streams of this gpu_sim on
+     */
+    executor& workers(void)
+    {
+        return _workers;
+    }
+
+    /**
+     * @brief concurrency The number of worker threads
+     */
+    std::size_t concurrency(void) const
+    {
+        return _workers.concurrency();
+    }
+
     /**
      * @brief start_fmt Starts the simulation with a specific format
-     * @tparam Args The arguments types of the callback function
+     * @tparam Kernel The callback type, void(const thread_index&, Args&...): a lambda or a functor gets inlined in the
+     *         loop over x, a gpu_callback works too
+     * @tparam Format The format type, thread_index(const thread_index&): an index_swizzle gets inlined, a
+     *         gpu_index_format or XYZ ... ZYX work too
      * @param size The size of the 3D space
      * @param callback The callback function
      * @param format The format of the index of a thread
-     * @param args The arguments of the callback function
+     * @param args The arguments of the callback function (passed as lvalues, once per index)
      * @return void
+     * @details Runs on the launch engine, x is cut in rows of SILVA_THREADS_GPU_SIM_ROW_SIZE indexes each run as a
+     *          plain loop, and returns once every index is done
+     */
+    template<typename Kernel, typename Format, typename... Args>
+    void start_fmt(const thread_index& size,
+        Kernel&& callback,
+        Format&& format,
+        Args&&... args)
+    {
+        _start_fmt(size, callback, format, args...);
+    }
+
+    /**
+     * @brief start_fmt The gpu_callback signature of start_fmt, kept for the callers spelling its Args
+     *        (start_fmt<int&>(...))
      */
     template<typename... Args>
     void start_fmt(const thread_index& size,
         gpu_callback<Args...>&& callback,
         gpu_index_format&& format,
         Args&&... args)
-
     {
-        for (const thread_index& index : thread_index::iterable(size))
-        {
-            _pool.start(
-                [](const thread_index& lindex, gpu_callback<Args...>&& lcallback, Args&&... largs)
-                {
-                    lcallback(lindex, std::forward<Args>(largs)...);
-                }, format(index), std::forward<gpu_callback<Args...>>(callback), std::forward<Args>(args)...
-            );
-        }
+        _start_fmt(size, callback, format, args...);
     }
 
     /**
      * @brief start Starts the simulation
+     * @tparam Kernel The callback type, see start_fmt
      * @tparam Args The arguments types of the callback function
      * @param size The size of the 3D space
      * @param callback The callback function
      * @param args The arguments of the callback function
      * @return void
      */
+    template<typename Kernel, typename... Args>
+    void start(const thread_index& size,
+        Kernel&& callback,
+        Args&&... args)
+    {
+        swizzle_xyz format;
+
+        _start_fmt(size, callback, format, args...);
+    }
+
+    /**
+     * @brief start The gpu_callback signature of start, kept for the callers spelling its Args (start<int&>(...))
+     */
     template<typename... Args>
     void start(const thread_index& size,
         gpu_callback<Args...>&& callback,
         Args&&... args)
     {
-        start_fmt(size, std::forward<gpu_callback<Args...>>(callback), XYZ, std::forward<Args>(args)...);
+        swizzle_xyz format;
+
+        _start_fmt(size, callback, format, args...);
     }
 
     /**
@@ -224,10 +1046,51 @@ public:
     /**
      * @brief join Waits until all current tasks have finished
      * @return void
+     * @details Launches are synchronous, this only waits for tasks still queued on the workers
      */
     void join(void)
     {
-        _pool.join();
+        _workers.wait_idle();
+    }
+
+private:
+    template<typename Kernel, typename Format, typename... Args>
+    void _start_fmt(const thread_index& size, Kernel& callback, Format& format, Args&... args)
+    {
+        if (size.x == 0)
+        {
+            return;
+        }
+
+        const unsigned int row = size.x < SILVA_THREADS_GPU_SIM_ROW_SIZE ? size.x : SILVA_THREADS_GPU_SIM_ROW_SIZE;
+        const thread_index grid((size.x + row - 1) / row, size.y, size.z);
+
+        _for_each_chunk<linear_order>(grid, [&](const blocked_range<std::size_t>& chunk) {
+            for (std::size_t linear = chunk.begin(); linear != chunk.end(); linear++)
+            {
+                thread_index block;
+
+                linear_order::at(grid, linear, block);
+                const unsigned int begin = block.x * row;
+                const unsigned int end = size.x - begin < row ? size.x : begin + row;
+
+                for (unsigned int x = begin; x < end; x++)
+                {
+                    callback(format(thread_index(x, block.y, block.z)), args...);
+                }
+            }
+        });
+    }
+
+    // spreads the positions of the blocks of grid in Order over the workers, in chunks of consecutive positions
+    template<typename Order, typename ChunkFunction>
+    void _for_each_chunk(const thread_index& grid, ChunkFunction&& fn)
+    {
+        if (grid.x == 0 || grid.y == 0 || grid.z == 0)
+        {
+            return;
+        }
+        parallel_for(_workers, blocked_range<std::size_t>(0, Order::count(grid)), fn);
     }
 };
 
@@ -0,0 +1,222 @@
+/**
+ * hl/silva/collections/threads/lane_vector.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/stdint.hpp>
+
+#include <cstddef>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+/**
+ * @brief lane_mask One bit per lane, lane 0 being the lowest bit
+ */
+using lane_mask = stdint::u64;
+
+/**
+ * @brief lane_vector One value per lane of a warp, the operations are plain loops over the lanes that the compiler
+ *        turns into SIMD instructions (8 float lanes fill an AVX2 register, 16 an AVX-512 one)
+ * @tparam Lanes a power of two, at most 64
+ */
+template<typename T, std::size_t Lanes>
+struct lane_vector
+{
+    static_assert(Lanes != 0 && (Lanes & (Lanes - 1)) == 0 && Lanes <= 64, "lane_vector lanes must be a power of two up to 64");
+
+    T values[Lanes];
+
+    lane_vector() = default;
+
+    /**
+     * @brief Broadcast value to every lane
+     */
+    lane_vector(const T& value)
+    {
+        for (std::size_t lane = 0; lane < Lanes; lane++)
+        {
+            values[lane] = value;
+        }
+    }
+
+    static constexpr std::size_t size()
+    {
+        return Lanes;
+    }
+
+    T& operator[](std::size_t lane)
+    {
+        return values[lane];
+    }
+
+    const T& operator[](std::size_t lane) const
+    {
+        return values[lane];
+    }
+
+#define SILVA_LANE_VECTOR_OPERATOR(OP)                                                          \
+    lane_vector& operator OP##=(const lane_vector& other)                                       \
+    {                                                                                           \
+        for (std::size_t lane = 0; lane < Lanes; lane++)                                        \
+        {                                                                                       \
+            values[lane] OP##= other.values[lane];                                              \
+        }                                                                                       \
+        return *this;                                                                           \
+    }                                                                                           \
+                                                                                                \
+    friend lane_vector operator OP(lane_vector left, const lane_vector& right)                  \
+    {                                                                                           \
+        left OP##= right;                                                                       \
+        return left;                                                                            \
+    }
+
+    SILVA_LANE_VECTOR_OPERATOR(+)
+    SILVA_LANE_VECTOR_OPERATOR(-)
+    SILVA_LANE_VECTOR_OPERATOR(*)
+    SILVA_LANE_VECTOR_OPERATOR(/)
+
+#undef SILVA_LANE_VECTOR_OPERATOR
+
+#define SILVA_LANE_VECTOR_COMPARISON(OP)                                                        \
+    friend lane_vector<bool, Lanes> operator OP(const lane_vector& left, const lane_vector& right) \
+    {                                                                                           \
+        lane_vector<bool, Lanes> result;                                                        \
+                                                                                                \
+        for (std::size_t lane = 0; lane < Lanes; lane++)                                        \
+        {                                                                                       \
+            result.values[lane] = left.values[lane] OP right.values[lane];                      \
+        }                                                                                       \
+        return result;                                                                          \
+    }
+
+    SILVA_LANE_VECTOR_COMPARISON(==)
+    SILVA_LANE_VECTOR_COMPARISON(!=)
+    SILVA_LANE_VECTOR_COMPARISON(<)
+    SILVA_LANE_VECTOR_COMPARISON(<=)
+    SILVA_LANE_VECTOR_COMPARISON(>)
+    SILVA_LANE_VECTOR_COMPARISON(>=)
+
+#undef SILVA_LANE_VECTOR_COMPARISON
+};
+
+/**
+ * @brief The lanes where predicate is true
+ */
+template<std::size_t Lanes>
+lane_mask to_mask(const lane_vector<bool, Lanes>& predicate)
+{
+    lane_mask mask = 0;
+
+    for (std::size_t lane = 0; lane < Lanes; lane++)
+    {
+        mask |= lane_mask(predicate.values[lane]) << lane;
+    }
+    return mask;
+}
+
+/**
+ * @brief select Per lane choice, if_true where the lane of mask is set and if_false elsewhere
+ */
+template<typename T, std::size_t Lanes>
+lane_vector<T, Lanes> select(lane_mask mask, const lane_vector<T, Lanes>& if_true, const lane_vector<T, Lanes>& if_false)
+{
+    lane_vector<T, Lanes> result;
+
+    for (std::size_t lane = 0; lane < Lanes; lane++)
+    {
+        result.values[lane] = (mask >> lane) & 1 ? if_true.values[lane] : if_false.values[lane];
+    }
+    return result;
+}
+
+/**
+ * @brief shuffle Lane i gets the value of lane source[i] (__shfl_sync), the source lane is taken modulo Lanes
+ */
+template<typename T, std::size_t Lanes>
+lane_vector<T, Lanes> shuffle(const lane_vector<T, Lanes>& value, const lane_vector<unsigned int, Lanes>& source)
+{
+    lane_vector<T, Lanes> result;
+
+    for (std::size_t lane = 0; lane < Lanes; lane++)
+    {
+        result.values[lane] = value.values[source.values[lane] & (Lanes - 1)];
+    }
+    return result;
+}
+
+/**
+ * @brief shuffle_xor Lane i gets the value of lane i ^ mask (__shfl_xor_sync), the butterfly of warp reductions
+ */
+template<typename T, std::size_t Lanes>
+lane_vector<T, Lanes> shuffle_xor(const lane_vector<T, Lanes>& value, std::size_t mask)
+{
+    lane_vector<T, Lanes> result;
+
+    for (std::size_t lane = 0; lane < Lanes; lane++)
+    {
+        result.values[lane] = value.values[(lane ^ mask) & (Lanes - 1)];
+    }
+    return result;
+}
+
+/**
+ * @brief shuffle_down Lane i gets the value of lane i + delta, the last delta lanes keep their value (__shfl_down_sync)
+ */
+template<typename T, std::size_t Lanes>
+lane_vector<T, Lanes> shuffle_down(const lane_vector<T, Lanes>& value, std::size_t delta)
+{
+    lane_vector<T, Lanes> result;
+
+    for (std::size_t lane = 0; lane < Lanes; lane++)
+    {
+        result.values[lane] = value.values[lane + delta < Lanes ? lane + delta : lane];
+    }
+    return result;
+}
+
+/**
+ * @brief shuffle_up Lane i gets the value of lane i - delta, the first delta lanes keep their value (__shfl_up_sync)
+ */
+template<typename T, std::size_t Lanes>
+lane_vector<T, Lanes> shuffle_up(const lane_vector<T, Lanes>& value, std::size_t delta)
+{
+    lane_vector<T, Lanes> result;
+
+    for (std::size_t lane = 0; lane < Lanes; lane++)
+    {
+        result.values[lane] = value.values[lane >= delta ? lane - delta : lane];
+    }
+    return result;
+}
+
+}
+}
+}
+}
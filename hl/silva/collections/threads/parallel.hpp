@@ -0,0 +1,359 @@
+/**
+ * hl/silva/collections/threads/parallel.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/threads/task.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
+#include <hl/silva/collections/thread_safe/_base.hpp>
+#include <hl/silva/collections/stdint.hpp>
+
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <exception>
+#include <type_traits>
+
+// Automatic grain: the range is cut in about this many chunks per participant, for load balancing
+#ifndef SILVA_THREADS_PARALLEL_CHUNKS_PER_WORKER
+#define SILVA_THREADS_PARALLEL_CHUNKS_PER_WORKER 4
+#endif
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+/**
+ * @brief blocked_range A [begin, end) range of integers cut in chunks of grain elements (0 = automatic)
+ */
+template<typename I>
+class blocked_range
+{
+    static_assert(std::is_integral<I>::value, "blocked_range requires an integral type");
+
+private:
+    I m_begin;
+    I m_end;
+    std::size_t m_grain;
+
+public:
+    blocked_range(I begin, I end, std::size_t grain = 0)
+        : m_begin(begin)
+        , m_end(end)
+        , m_grain(grain)
+    {}
+
+    I begin() const
+    {
+        return m_begin;
+    }
+
+    I end() const
+    {
+        return m_end;
+    }
+
+    std::size_t grain() const
+    {
+        return m_grain;
+    }
+
+    std::size_t size() const
+    {
+        return m_end > m_begin ? std::size_t(m_end - m_begin) : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+};
+
+/**
+ * @brief parallel_job Shared state of a parallel_for / parallel_reduce call
+ * @details The range is cut in chunks of grain elements and every participant (the caller and up to
+ *          concurrency() - 1 tasks posted on the executor) claims the next chunk from an atomic counter until
+ *          there are none left. The caller can do all the work by itself, so a call from a worker of a busy
+ *          pool does not deadlock, and helper tasks starting late simply find nothing to do.
+ */
+template<typename I>
+class parallel_job
+{
+public:
+    using chunk_function = void (*)(void* body, std::size_t participant, const blocked_range<I>& chunk);
+
+private:
+    atomic<stdint::u32> m_references;
+
+    I m_begin;
+    I m_end;
+    std::size_t m_grain;
+    std::size_t m_chunks;
+
+    void* m_body;
+    chunk_function m_function;
+
+    atomic_size_t m_next;
+    atomic_size_t m_finished;
+    atomic_bool m_failed;
+
+    thread_safe::mutex m_mutex;
+    condition_variable m_condition;
+    bool m_done;
+    std::exception_ptr m_error;
+
+    parallel_job(stdint::u32 references, I begin, I end, std::size_t grain, std::size_t chunks, void* body, chunk_function function)
+        : m_references(references)
+        , m_begin(begin)
+        , m_end(end)
+        , m_grain(grain)
+        , m_chunks(chunks)
+        , m_body(body)
+        , m_function(function)
+        , m_next(0)
+        , m_finished(0)
+        , m_failed(false)
+        , m_mutex()
+        , m_condition()
+        , m_done(false)
+        , m_error()
+    {}
+
+public:
+    /**
+     * @brief Number of participants (and of accumulators for a reduction) used on ex
+     */
+    static std::size_t participants(const executor& ex)
+    {
+        const std::size_t count = ex.concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    static std::size_t grain(const blocked_range<I>& range, std::size_t participants)
+    {
+        if (range.grain() != 0)
+        {
+            return range.grain();
+        }
+
+        const std::size_t chunks = participants * SILVA_THREADS_PARALLEL_CHUNKS_PER_WORKER;
+        const std::size_t grain = (range.size() + chunks - 1) / chunks;
+
+        return grain == 0 ? 1 : grain;
+    }
+
+    /**
+     * @brief Call function(body, participant, chunk) for every chunk of range and wait, rethrows the first exception
+     * @details Once a chunk throws, the chunks not started yet are skipped
+     */
+    static void run(executor& ex, const blocked_range<I>& range, std::size_t participants, void* body, chunk_function function)
+    {
+        if (range.empty())
+        {
+            return;
+        }
+
+        const std::size_t chunk_size = grain(range, participants);
+        const std::size_t chunks = (range.size() + chunk_size - 1) / chunk_size;
+        const std::size_t helpers = (participants < chunks ? participants : chunks) - 1;
+
+        if (helpers == 0)
+        {
+            for (std::size_t chunk = 0; chunk < chunks; chunk++)
+            {
+                const I begin = I(range.begin() + I(chunk * chunk_size));
+                const I end = chunk + 1 == chunks ? range.end() : I(begin + I(chunk_size));
+
+                function(body, 0, blocked_range<I>(begin, end, chunk_size));
+            }
+            return;
+        }
+
+        parallel_job* job = new parallel_job(stdint::u32(helpers + 1), range.begin(), range.end(), chunk_size, chunks, body, function);
+
+        for (std::size_t participant = 1; participant <= helpers; participant++)
+        {
+            if (!ex.post(task([job, participant]() {
+                job->_work(participant);
+                job->_release();
+            })))
+            {
+                job->_release();
+            }
+        }
+
+        job->_work(0);
+
+        std::exception_ptr error;
+        {
+            std::unique_lock<thread_safe::mutex> lock(job->m_mutex);
+
+            job->m_condition.wait(lock, [job]() { return job->m_done; });
+            std::swap(error, job->m_error);
+        }
+        job->_release();
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void _release()
+    {
+        if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    void _work(std::size_t participant)
+    {
+        while (true)
+        {
+            const std::size_t chunk = m_next.fetch_add(1, std::memory_order_relaxed);
+
+            if (chunk >= m_chunks)
+            {
+                return;
+            }
+
+            if (!m_failed.load(std::memory_order_relaxed))
+            {
+                const I begin = I(m_begin + I(chunk * m_grain));
+                const I end = chunk + 1 == m_chunks ? m_end : I(begin + I(m_grain));
+
+                try
+                {
+                    m_function(m_body, participant, blocked_range<I>(begin, end, m_grain));
+                }
+                catch (...)
+                {
+                    thread_safe::lock_guard lock(m_mutex);
+
+                    if (!m_error)
+                    {
+                        m_error = std::current_exception();
+                    }
+                    m_failed.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            if (m_finished.fetch_add(1, std::memory_order_acq_rel) + 1 == m_chunks)
+            {
+                thread_safe::lock_guard lock(m_mutex);
+
+                m_done = true;
+                m_condition.notify_all();
+            }
+        }
+    }
+};
+
+/**
+ * @brief Call fn(chunk) for chunks of range on ex, in parallel, and wait for them
+ * @param fn void(const blocked_range<I>&)
+ */
+template<typename I, typename F>
+void parallel_for(executor& ex, const blocked_range<I>& range, F&& fn)
+{
+    using function_type = typename std::remove_reference<F>::type;
+
+    parallel_job<I>::run(ex, range, parallel_job<I>::participants(ex), (void*)&fn,
+        [](void* body, std::size_t, const blocked_range<I>& chunk) {
+            (*static_cast<function_type*>(body))(chunk);
+        });
+}
+
+/**
+ * @brief Call fn(i) for every i in [begin, end) on ex, in parallel, and wait for them
+ * @param grain the number of indexes per task, 0 for automatic
+ */
+template<typename B, typename E, typename F>
+void parallel_for(executor& ex, B begin, E end, F&& fn, std::size_t grain = 0)
+{
+    using index_type = typename std::common_type<B, E>::type;
+
+    parallel_for(ex, blocked_range<index_type>(index_type(begin), index_type(end), grain),
+        [&fn](const blocked_range<index_type>& chunk) {
+            for (index_type i = chunk.begin(); i != chunk.end(); i++)
+            {
+                fn(i);
+            }
+        });
+}
+
+/**
+ * @brief Reduce range on ex: every participant folds its chunks into its own accumulator, then they are combined
+ * @param identity the initial value of every accumulator
+ * @param body T(const blocked_range<I>& chunk, T accumulator), folds a chunk into the accumulator
+ * @param combine T(T, T), associative
+ * @details The accumulators are padded to a cache line. The accumulators are combined in a fixed order but
+ *          the chunks a participant gets are not, so a non commutative combine gets a nondeterministic result.
+ */
+template<typename I, typename T, typename Body, typename Combine>
+T parallel_reduce(executor& ex, const blocked_range<I>& range, T identity, Body&& body, Combine&& combine)
+{
+    struct alignas(SILVA_THREADS_CACHE_LINE_SIZE) accumulator
+    {
+        T value;
+    };
+
+    struct context
+    {
+        typename std::remove_reference<Body>::type& body;
+        std::vector<accumulator>& accumulators;
+    };
+
+    const std::size_t participants = parallel_job<I>::participants(ex);
+    std::vector<accumulator> accumulators(participants, accumulator { identity });
+    context ctx { body, accumulators };
+
+    parallel_job<I>::run(ex, range, participants, (void*)&ctx,
+        [](void* data, std::size_t participant, const blocked_range<I>& chunk) {
+            context& c = *static_cast<context*>(data);
+            T& value = c.accumulators[participant].value;
+
+            value = c.body(chunk, std::move(value));
+        });
+
+    T result = std::move(identity);
+
+    for (accumulator& a : accumulators)
+    {
+        result = combine(std::move(result), std::move(a.value));
+    }
+    return result;
+}
+
+}
+}
+}
+}
@@ -0,0 +1,374 @@
+/**
+ * hl/silva/collections/threads/stream.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/threads/task.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
+#include <hl/silva/collections/thread_safe/_base.hpp>
+#include <hl/silva/collections/stdint.hpp>
+#include <hl/silva/collections/meta.hpp>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <exception>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+class stream;
+
+/**
+ * @brief event A point in the work of a stream, recorded on one stream and waited for by others or by the host
+ * @details Every record() is a new generation completed when the stream reaches it. wait() and synchronize() use
+ *          the most recent record at the time of the call, an event never recorded counts as complete.
+ *          The event must outlive the operations recorded or waiting on it.
+ */
+class event : public meta::NonCopyMoveable
+{
+private:
+    friend class stream;
+
+    struct waiter
+    {
+        stdint::u64 generation;
+        task resume;
+    };
+
+    thread_safe::mutex m_mutex;
+    condition_variable m_completed_condition;
+    stdint::u64 m_recorded;
+    stdint::u64 m_completed;
+    std::vector<waiter> m_waiters;
+
+public:
+    event()
+        : m_mutex()
+        , m_completed_condition()
+        , m_recorded(0)
+        , m_completed(0)
+        , m_waiters()
+    {}
+
+    virtual ~event() override = default;
+
+    /**
+     * @brief Complete the event once everything queued on s so far is done (cudaEventRecord)
+     */
+    inline void record(stream& s);
+
+    /**
+     * @brief Whether the most recent record is complete
+     */
+    bool query()
+    {
+        thread_safe::lock_guard lock(m_mutex);
+        return m_completed >= m_recorded;
+    }
+
+    /**
+     * @brief Block the calling thread until the most recent record is complete
+     */
+    void synchronize()
+    {
+        std::unique_lock<thread_safe::mutex> lock(m_mutex);
+        const stdint::u64 generation = m_recorded;
+
+        m_completed_condition.wait(lock, [this, generation]() { return m_completed >= generation; });
+    }
+
+private:
+    stdint::u64 _generation()
+    {
+        thread_safe::lock_guard lock(m_mutex);
+        return m_recorded;
+    }
+
+    void _complete(stdint::u64 generation)
+    {
+        std::vector<task> ready;
+        {
+            thread_safe::lock_guard lock(m_mutex);
+
+            if (generation > m_completed)
+            {
+                m_completed = generation;
+            }
+
+            for (std::size_t i = 0; i < m_waiters.size();)
+            {
+                if (m_waiters[i].generation <= m_completed)
+                {
+                    ready.push_back(std::move(m_waiters[i].resume));
+                    m_waiters[i] = std::move(m_waiters.back());
+                    m_waiters.pop_back();
+                }
+                else
+                {
+                    i++;
+                }
+            }
+
+            // under the lock: a host thread returning from synchronize() may destroy the event right after
+            m_completed_condition.notify_all();
+        }
+
+        for (task& resume : ready)
+        {
+            resume();
+        }
+    }
+
+    // runs resume once generation is complete, false (resume untouched) when it already is
+    bool _on_complete(stdint::u64 generation, task&& resume)
+    {
+        thread_safe::lock_guard lock(m_mutex);
+
+        if (m_completed >= generation)
+        {
+            return false;
+        }
+        m_waiters.push_back(waiter { generation, std::move(resume) });
+        return true;
+    }
+};
+
+/**
+ * @brief stream Ordered queue of tasks running on another executor (a CUDA stream)
+ * @details The tasks of a stream run one after the other, in order, while different streams on the same executor
+ *          run concurrently. A stream only occupies a worker while it has tasks to run, and waiting for an event
+ *          suspends it without blocking any thread. The first exception thrown by a task is rethrown by
+ *          synchronize(), the following tasks still run. The destructor waits for the queued tasks.
+ */
+class stream : public executor, public meta::NonCopyMoveable
+{
+private:
+    friend class event;
+
+    executor& m_executor;
+
+    thread_safe::mutex m_mutex;
+    condition_variable m_idle;
+    std::deque<task> m_queue;
+    std::size_t m_pending;      // queued or running tasks
+    bool m_running;             // a drain is posted or running
+    bool m_suspended;           // waiting for an event
+    std::exception_ptr m_error;
+
+public:
+    /**
+     * @param ex the executor running the tasks of the stream
+     */
+    stream(executor& ex)
+        : m_executor(ex)
+        , m_mutex()
+        , m_idle()
+        , m_queue()
+        , m_pending(0)
+        , m_running(false)
+        , m_suspended(false)
+        , m_error()
+    {}
+
+    virtual ~stream() override
+    {
+        _wait();
+    }
+
+    using executor::post;
+
+    /**
+     * @brief The tasks queued after this call only start once e's most recent record is complete (cudaStreamWaitEvent)
+     */
+    void wait(event& e)
+    {
+        const stdint::u64 generation = e._generation();
+
+        if (generation == 0)
+        {
+            return;
+        }
+
+        _post(task([this, &e, generation]() {
+            // the event resumes us outside of its lock, so registering under ours cannot miss the resume
+            thread_safe::lock_guard lock(m_mutex);
+
+            if (e._on_complete(generation, task([this]() { _resume(); })))
+            {
+                m_suspended = true;
+            }
+        }));
+    }
+
+    /**
+     * @brief Wait until every task queued so far is done, rethrows the first exception of a task
+     */
+    void synchronize()
+    {
+        _wait();
+
+        std::exception_ptr error;
+        {
+            thread_safe::lock_guard lock(m_mutex);
+            std::swap(error, m_error);
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /**
+     * @brief Whether every task queued so far is done
+     */
+    bool query()
+    {
+        thread_safe::lock_guard lock(m_mutex);
+        return m_pending == 0;
+    }
+
+    /**
+     * @brief A stream runs one task at a time
+     */
+    virtual std::size_t concurrency() const override
+    {
+        return 1;
+    }
+
+protected:
+    virtual bool _post(task&& t) override
+    {
+        bool schedule = false;
+        {
+            thread_safe::lock_guard lock(m_mutex);
+
+            m_queue.push_back(std::move(t));
+            m_pending++;
+            if (!m_running && !m_suspended)
+            {
+                m_running = true;
+                schedule = true;
+            }
+        }
+
+        if (schedule)
+        {
+            _schedule();
+        }
+        return true;
+    }
+
+private:
+    void _schedule()
+    {
+        if (!m_executor.post(task([this]() { _drain(); })))
+        {
+            _drain();
+        }
+    }
+
+    void _wait()
+    {
+        std::unique_lock<thread_safe::mutex> lock(m_mutex);
+
+        m_idle.wait(lock, [this]() { return m_pending == 0 && !m_running; });
+    }
+
+    void _resume()
+    {
+        bool schedule = false;
+        {
+            thread_safe::lock_guard lock(m_mutex);
+
+            m_suspended = false;
+            if (!m_running && !m_queue.empty())
+            {
+                m_running = true;
+                schedule = true;
+            }
+        }
+
+        if (schedule)
+        {
+            _schedule();
+        }
+    }
+
+    // runs the queued tasks in order until the queue is empty or the stream is suspended
+    void _drain()
+    {
+        std::unique_lock<thread_safe::mutex> lock(m_mutex);
+
+        while (!m_queue.empty() && !m_suspended)
+        {
+            task current = std::move(m_queue.front());
+
+            m_queue.pop_front();
+            lock.unlock();
+            try
+            {
+                current();
+            }
+            catch (...)
+            {
+                lock.lock();
+                if (!m_error)
+                {
+                    m_error = std::current_exception();
+                }
+                lock.unlock();
+            }
+            current.reset();
+            lock.lock();
+            m_pending--;
+        }
+        m_running = false;
+        m_idle.notify_all();
+    }
+};
+
+inline void event::record(stream& s)
+{
+    stdint::u64 generation;
+    {
+        thread_safe::lock_guard lock(m_mutex);
+        generation = ++m_recorded;
+    }
+
+    s._post(task([this, generation]() { _complete(generation); }));
+}
+
+}
+}
+}
+}
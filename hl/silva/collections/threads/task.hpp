@@ -0,0 +1,183 @@
+/**
+ * hl/silva/collections/threads/task.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/meta.hpp>
+
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+#ifndef SILVA_THREADS_TASK_INLINE_SIZE
+#define SILVA_THREADS_TASK_INLINE_SIZE (6 * sizeof(void*))
+#endif
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+/**
+ * @brief task A move only type erased void() callable
+ * @details Callables up to SILVA_THREADS_TASK_INLINE_SIZE bytes (with a noexcept move) are stored inline,
+ *          so that queuing a task is a move of a few words without allocation, bigger ones are heap allocated
+ */
+class task
+{
+public:
+    HL_INLINE_CONSTEXPR_VARIABLE std::size_t INLINE_SIZE = SILVA_THREADS_TASK_INLINE_SIZE;
+
+private:
+    struct vtable
+    {
+        void (*invoke)(void* storage);
+        void (*move)(void* destination, void* source); // move constructs destination and destroys source
+        void (*destroy)(void* storage);
+    };
+
+    template<typename F>
+    struct is_inline : std::integral_constant<bool,
+        sizeof(F) <= INLINE_SIZE &&
+        alignof(F) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible<F>::value>
+    {};
+
+    template<typename F>
+    static void _invoke_inline(void* storage) { (*static_cast<F*>(storage))(); }
+
+    template<typename F>
+    static void _move_inline(void* destination, void* source)
+    {
+        ::new (destination) F(std::move(*static_cast<F*>(source)));
+        static_cast<F*>(source)->~F();
+    }
+
+    template<typename F>
+    static void _destroy_inline(void* storage) { static_cast<F*>(storage)->~F(); }
+
+    template<typename F>
+    static void _invoke_heap(void* storage) { (**static_cast<F**>(storage))(); }
+
+    template<typename F>
+    static void _move_heap(void* destination, void* source) { *static_cast<F**>(destination) = *static_cast<F**>(source); }
+
+    template<typename F>
+    static void _destroy_heap(void* storage) { delete *static_cast<F**>(storage); }
+
+    template<typename F>
+    static constexpr vtable _inline_vtable = { &_invoke_inline<F>, &_move_inline<F>, &_destroy_inline<F> };
+
+    template<typename F>
+    static constexpr vtable _heap_vtable = { &_invoke_heap<F>, &_move_heap<F>, &_destroy_heap<F> };
+
+    alignas(std::max_align_t) unsigned char m_storage[INLINE_SIZE];
+    const vtable* m_vtable = nullptr;
+
+public:
+    task() noexcept = default;
+
+    template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, task>::value>::type>
+    task(F&& f)
+    {
+        using callable = typename std::decay<F>::type;
+
+        HL_IF_CONSTEXPR (is_inline<callable>::value)
+        {
+            ::new (static_cast<void*>(m_storage)) callable(std::forward<F>(f));
+            m_vtable = &_inline_vtable<callable>;
+        }
+        else
+        {
+            *reinterpret_cast<callable**>(m_storage) = new callable(std::forward<F>(f));
+            m_vtable = &_heap_vtable<callable>;
+        }
+    }
+
+    task(task&& other) noexcept
+        : m_vtable(other.m_vtable)
+    {
+        if (m_vtable != nullptr)
+        {
+            m_vtable->move(m_storage, other.m_storage);
+            other.m_vtable = nullptr;
+        }
+    }
+
+    task& operator=(task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            m_vtable = other.m_vtable;
+
+            if (m_vtable != nullptr)
+            {
+                m_vtable->move(m_storage, other.m_storage);
+                other.m_vtable = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task()
+    {
+        reset();
+    }
+
+    /**
+     * @brief Destroy the stored callable (the task becomes empty)
+     */
+    void reset() noexcept
+    {
+        if (m_vtable != nullptr)
+        {
+            m_vtable->destroy(m_storage);
+            m_vtable = nullptr;
+        }
+    }
+
+    void operator()()
+    {
+        m_vtable->invoke(m_storage);
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_vtable != nullptr;
+    }
+};
+
+}
+}
+}
+}
@@ -0,0 +1,315 @@
+/**
+ * hl/silva/collections/threads/task_graph.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/threads/task.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
+#include <hl/silva/collections/thread_safe/_base.hpp>
+#include <hl/silva/collections/meta.hpp>
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+/**
+ * @brief task_graph A DAG of tasks built once and run any number of times on an executor
+ * @details Every node has an atomic counter of unfinished predecessors, reset at the start of a run: the node
+ *          finishing last releases its successor. The first released successor runs right away in the same
+ *          thread, the others are posted. A run does not allocate (besides what the executor needs to queue
+ *          a task, nothing for a fixed_pool).
+ */
+class task_graph : public meta::NonCopyMoveable
+{
+public:
+    using node = std::size_t;
+
+    HL_INLINE_CONSTEXPR_VARIABLE node npos = node(-1);
+
+private:
+    struct node_data
+    {
+        task work;
+        std::vector<node> successors;
+        std::size_t predecessors;
+    };
+
+    std::vector<node_data> m_nodes;
+
+    // built by _prepare when the graph changed
+    bool m_prepared;
+    std::vector<node> m_roots;
+    std::unique_ptr<atomic_size_t[]> m_remaining;
+
+    // current run
+    executor* m_executor;
+    atomic_size_t m_pending;
+    atomic_bool m_failed;
+    std::exception_ptr m_error;
+    bool m_running;
+    bool m_done;
+    thread_safe::mutex m_mutex;
+    condition_variable m_finished;
+
+public:
+    task_graph()
+        : m_nodes()
+        , m_prepared(false)
+        , m_roots()
+        , m_remaining()
+        , m_executor(nullptr)
+        , m_pending(0)
+        , m_failed(false)
+        , m_error()
+        , m_running(false)
+        , m_done(false)
+        , m_mutex()
+        , m_finished()
+    {}
+
+    virtual ~task_graph() override = default;
+
+    /**
+     * @brief Add a node running f
+     * @return the node, to use with add_edge
+     */
+    template<typename F>
+    node add(F&& f)
+    {
+        _check_not_running();
+        m_nodes.push_back(node_data { task(std::forward<F>(f)), {}, 0 });
+        m_prepared = false;
+        return m_nodes.size() - 1;
+    }
+
+    /**
+     * @brief after only starts once before is done
+     */
+    void add_edge(node before, node after)
+    {
+        _check_not_running();
+        if (before >= m_nodes.size() || after >= m_nodes.size())
+        {
+            throw std::out_of_range("task_graph: unknown node");
+        }
+
+        m_nodes[before].successors.push_back(after);
+        m_nodes[after].predecessors++;
+        m_prepared = false;
+    }
+
+    std::size_t size() const
+    {
+        return m_nodes.size();
+    }
+
+    void clear()
+    {
+        _check_not_running();
+        m_nodes.clear();
+        m_prepared = false;
+    }
+
+    /**
+     * @brief Run the whole graph on ex and wait for it
+     * @details Once a node throws, the nodes not started yet are skipped and the first exception is rethrown.
+     *          Throws std::logic_error when the graph has a cycle. Must not be called from a worker of ex
+     *          (it blocks), nor while the graph is already running.
+     */
+    void run(executor& ex)
+    {
+        _check_not_running();
+        _prepare();
+
+        if (m_nodes.empty())
+        {
+            return;
+        }
+
+        for (std::size_t i = 0; i < m_nodes.size(); i++)
+        {
+            m_remaining[i].store(m_nodes[i].predecessors, std::memory_order_relaxed);
+        }
+        m_executor = &ex;
+        m_pending.store(m_nodes.size(), std::memory_order_relaxed);
+        m_failed.store(false, std::memory_order_relaxed);
+        m_error = nullptr;
+        m_done = false;
+        m_running = true;
+
+        for (node root : m_roots)
+        {
+            _schedule(root);
+        }
+
+        std::exception_ptr error;
+        {
+            std::unique_lock<thread_safe::mutex> lock(m_mutex);
+
+            m_finished.wait(lock, [this]() { return m_done; });
+            m_running = false;
+            std::swap(error, m_error);
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void _check_not_running() const
+    {
+        if (m_running)
+        {
+            throw std::logic_error("task_graph: the graph is running");
+        }
+    }
+
+    // roots, counters and cycle check (Kahn), only when the graph changed
+    void _prepare()
+    {
+        if (m_prepared)
+        {
+            return;
+        }
+
+        const std::size_t count = m_nodes.size();
+        std::vector<std::size_t> remaining(count);
+        std::vector<node> ready;
+
+        m_roots.clear();
+        for (node i = 0; i < count; i++)
+        {
+            remaining[i] = m_nodes[i].predecessors;
+            if (remaining[i] == 0)
+            {
+                m_roots.push_back(i);
+            }
+        }
+
+        ready = m_roots;
+        std::size_t visited = 0;
+
+        while (!ready.empty())
+        {
+            const node current = ready.back();
+
+            ready.pop_back();
+            visited++;
+            for (node successor : m_nodes[current].successors)
+            {
+                if (--remaining[successor] == 0)
+                {
+                    ready.push_back(successor);
+                }
+            }
+        }
+
+        if (visited != count)
+        {
+            throw std::logic_error("task_graph: the graph has a cycle");
+        }
+
+        m_remaining.reset(count == 0 ? nullptr : new atomic_size_t[count]);
+        m_prepared = true;
+    }
+
+    void _schedule(node n)
+    {
+        if (!m_executor->post(task([this, n]() { _execute(n); })))
+        {
+            _execute(n);
+        }
+    }
+
+    void _execute(node n)
+    {
+        while (n != npos)
+        {
+            node_data& data = m_nodes[n];
+
+            if (!m_failed.load(std::memory_order_relaxed))
+            {
+                try
+                {
+                    data.work();
+                }
+                catch (...)
+                {
+                    thread_safe::lock_guard lock(m_mutex);
+
+                    if (!m_error)
+                    {
+                        m_error = std::current_exception();
+                    }
+                    m_failed.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            // the first released successor continues in this thread
+            node next = npos;
+
+            for (node successor : data.successors)
+            {
+                if (m_remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    if (next == npos)
+                    {
+                        next = successor;
+                    }
+                    else
+                    {
+                        _schedule(successor);
+                    }
+                }
+            }
+
+            if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                thread_safe::lock_guard lock(m_mutex);
+
+                m_done = true;
+                m_finished.notify_all();
+            }
+            n = next;
+        }
+    }
+};
+
+}
+}
+}
+}
@@ -0,0 +1,244 @@
+/**
+ * hl/silva/collections/threads/traversal.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+/**
+ * Traversal orders of a 3D index space (anything with unsigned x, y, z and a (x, y, z) constructor), chosen at
+ * compile time. An order has:
+ *  - count(size): the number of positions, at least the number of indexes (an order may have holes)
+ *  - at(size, position, index): the index at a position, false for a hole
+ *  - for_each(size, f): calls f(index) for every index, in order
+ */
+
+/**
+ * @brief linear_order x first, then y, then z (the order of thread_index::iterator)
+ */
+struct linear_order
+{
+    template<typename Index>
+    static std::size_t count(const Index& size)
+    {
+        return std::size_t(size.x) * size.y * size.z;
+    }
+
+    template<typename Index>
+    static bool at(const Index& size, std::size_t position, Index& index)
+    {
+        index = Index(
+            (unsigned int)(position % size.x),
+            (unsigned int)((position / size.x) % size.y),
+            (unsigned int)(position / (std::size_t(size.x) * size.y)));
+        return true;
+    }
+
+    template<typename Index, typename F>
+    static void for_each(const Index& size, F&& f)
+    {
+        for (unsigned int z = 0; z < size.z; z++)
+        {
+            for (unsigned int y = 0; y < size.y; y++)
+            {
+                for (unsigned int x = 0; x < size.x; x++)
+                {
+                    f(Index(x, y, z));
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief tiled_order The space is cut in TX * TY * TZ tiles visited in linear order, each tile in linear order
+ * @details A tile of a 3D stencil fits in the cache, the neighbours of an index are visited shortly after it.
+ *          The tiles of the edges are clipped (holes in the positions)
+ */
+template<unsigned int TX = 8, unsigned int TY = 8, unsigned int TZ = 8>
+struct tiled_order
+{
+    static_assert(TX != 0 && TY != 0 && TZ != 0, "tiled_order tiles can not be empty");
+
+    template<typename Index>
+    static Index tiles(const Index& size)
+    {
+        return Index((size.x + TX - 1) / TX, (size.y + TY - 1) / TY, (size.z + TZ - 1) / TZ);
+    }
+
+    template<typename Index>
+    static std::size_t count(const Index& size)
+    {
+        return linear_order::count(tiles(size)) * (std::size_t(TX) * TY * TZ);
+    }
+
+    template<typename Index>
+    static bool at(const Index& size, std::size_t position, Index& index)
+    {
+        const std::size_t volume = std::size_t(TX) * TY * TZ;
+        Index tile;
+        Index offset;
+
+        linear_order::at(tiles(size), position / volume, tile);
+        linear_order::at(Index(TX, TY, TZ), position % volume, offset);
+        index = Index(tile.x * TX + offset.x, tile.y * TY + offset.y, tile.z * TZ + offset.z);
+        return index.x < size.x && index.y < size.y && index.z < size.z;
+    }
+
+    template<typename Index, typename F>
+    static void for_each(const Index& size, F&& f)
+    {
+        for (unsigned int tz = 0; tz < size.z; tz += TZ)
+        {
+            const unsigned int ez = size.z - tz < TZ ? size.z : tz + TZ;
+
+            for (unsigned int ty = 0; ty < size.y; ty += TY)
+            {
+                const unsigned int ey = size.y - ty < TY ? size.y : ty + TY;
+
+                for (unsigned int tx = 0; tx < size.x; tx += TX)
+                {
+                    const unsigned int ex = size.x - tx < TX ? size.x : tx + TX;
+
+                    for (unsigned int z = tz; z < ez; z++)
+                    {
+                        for (unsigned int y = ty; y < ey; y++)
+                        {
+                            for (unsigned int x = tx; x < ex; x++)
+                            {
+                                f(Index(x, y, z));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief morton_order Z-order curve: the bits of x, y and z interleaved (x lowest), every power of two sized
+ *        cube of the space is visited in one go
+ * @details Each dimension only gets the bits its size needs, so the positions outside of the space (holes) are
+ *          less than 8 times the number of indexes, none for power of two sizes
+ */
+struct morton_order
+{
+    static unsigned int bits(unsigned int size)
+    {
+        unsigned int count = 0;
+
+        while (count < 32 && (1ull << count) < size)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    template<typename Index>
+    static std::size_t count(const Index& size)
+    {
+        return std::size_t(1) << (bits(size.x) + bits(size.y) + bits(size.z));
+    }
+
+    template<typename Index>
+    static bool at(const Index& size, std::size_t position, Index& index)
+    {
+        const unsigned int bx = bits(size.x);
+        const unsigned int by = bits(size.y);
+        const unsigned int bz = bits(size.z);
+        unsigned int coordinates[3] = { 0, 0, 0 };
+
+        for (unsigned int level = 0; position != 0; level++)
+        {
+            if (level < bx)
+            {
+                coordinates[0] |= unsigned(position & 1) << level;
+                position >>= 1;
+            }
+            if (level < by)
+            {
+                coordinates[1] |= unsigned(position & 1) << level;
+                position >>= 1;
+            }
+            if (level < bz)
+            {
+                coordinates[2] |= unsigned(position & 1) << level;
+                position >>= 1;
+            }
+        }
+        index = Index(coordinates[0], coordinates[1], coordinates[2]);
+        return index.x < size.x && index.y < size.y && index.z < size.z;
+    }
+
+    template<typename Index, typename F>
+    static void for_each(const Index& size, F&& f)
+    {
+        const unsigned int levels = _max(bits(size.x), _max(bits(size.y), bits(size.z)));
+
+        _visit(size, 0, 0, 0, levels, f);
+    }
+
+private:
+    static unsigned int _max(unsigned int a, unsigned int b)
+    {
+        return a < b ? b : a;
+    }
+
+    // the cube of side 2^level at (x, y, z), clipped to the space, its 8 octants in Z order
+    template<typename Index, typename F>
+    static void _visit(const Index& size, unsigned int x, unsigned int y, unsigned int z, unsigned int level, F& f)
+    {
+        if (x >= size.x || y >= size.y || z >= size.z)
+        {
+            return;
+        }
+
+        if (level == 0)
+        {
+            f(Index(x, y, z));
+            return;
+        }
+
+        const unsigned int half = 1u << (level - 1);
+
+        for (unsigned int child = 0; child < 8; child++)
+        {
+            _visit(size, x + ((child & 1) ? half : 0), y + ((child & 2) ? half : 0), z + ((child & 4) ? half : 0), level - 1, f);
+        }
+    }
+};
+
+}
+}
+}
+}
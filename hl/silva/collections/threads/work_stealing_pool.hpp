@@ -0,0 +1,430 @@
+/**
+ * hl/silva/collections/threads/work_stealing_pool.hpp
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * Made by: Mattis DALLEAU
+ */
+
+#pragma once
+
+#include <hl/silva/collections/threads/_base.hpp>
+#include <hl/silva/collections/threads/executor.hpp>
+#include <hl/silva/collections/threads/chase_lev_deque.hpp>
+#include <hl/silva/collections/thread_safe/_base.hpp>
+#include <hl/silva/collections/stdint.hpp>
+#include <hl/silva/collections/meta.hpp>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <exception>
+
+#ifndef SILVA_THREADS_WORK_STEALING_SPIN_COUNT
+#define SILVA_THREADS_WORK_STEALING_SPIN_COUNT 64
+#endif
+
+namespace hl
+{
+namespace silva
+{
+namespace collections
+{
+namespace threads
+{
+
+class task_group;
+
+/**
+ * @brief work_stealing_pool Executor where every worker owns a chase_lev_deque
+ * @details A task posted from a worker is pushed on its own deque and popped back LIFO (cache friendly fork/join),
+ *          idle workers steal FIFO (the oldest, usually biggest, tasks) from victims starting at a random one.
+ *          Tasks posted from other threads go through a shared injection queue.
+ *          Workers spin a little before sleeping and are only woken up when some are asleep, so a busy pool
+ *          does not touch any shared lock. An exception escaping a task posted directly terminates like a
+ *          std::thread would, use a task_group to get it back.
+ */
+class work_stealing_pool : public executor, public meta::NonCopyMoveable
+{
+private:
+    friend class task_group;
+
+    std::vector<std::unique_ptr<chase_lev_deque<task*>>> m_deques;
+    std::vector<thread> m_workers;
+
+    thread_safe::mutex m_injected_mutex;
+    std::deque<task*> m_injected;
+    atomic_size_t m_injected_count;
+    bool m_stopping;                        // guarded by m_injected_mutex
+    atomic_bool m_stopped;
+
+    thread_safe::mutex m_sleep_mutex;
+    condition_variable m_wake;
+    atomic_size_t m_sleepers;
+    std::size_t m_signals;                  // guarded by m_sleep_mutex
+
+public:
+    /**
+     * @brief Construct a new work stealing pool object and start its workers
+     * @param workers the number of worker threads (0 means one per hardware thread)
+     */
+    work_stealing_pool(std::size_t workers = 0)
+        : m_deques()
+        , m_workers()
+        , m_injected_mutex()
+        , m_injected()
+        , m_injected_count(0)
+        , m_stopping(false)
+        , m_stopped(false)
+        , m_sleep_mutex()
+        , m_wake()
+        , m_sleepers(0)
+        , m_signals(0)
+    {
+        if (workers == 0)
+        {
+            workers = thread::hardware_concurrency();
+            workers = workers == 0 ? 1 : workers;
+        }
+
+        m_deques.reserve(workers);
+        for (std::size_t i = 0; i < workers; i++)
+        {
+            m_deques.emplace_back(new chase_lev_deque<task*>());
+        }
+
+        m_workers.reserve(workers);
+        for (std::size_t i = 0; i < workers; i++)
+        {
+            m_workers.emplace_back(&work_stealing_pool::_worker, this, i);
+        }
+    }
+
+    virtual ~work_stealing_pool() override
+    {
+        shutdown();
+    }
+
+    using executor::post;
+
+    /**
+     * @brief Run the queued tasks, stop the workers and join them, called by the destructor
+     * @details Workers can still post (subtasks of a running task) while draining, other threads get false.
+     *          Must not be called from a worker
+     */
+    void shutdown()
+    {
+        {
+            thread_safe::lock_guard lock(m_injected_mutex);
+            m_stopping = true;
+        }
+        m_stopped.store(true);
+        {
+            thread_safe::lock_guard lock(m_sleep_mutex);
+            m_signals = m_workers.size();
+        }
+        m_wake.notify_all();
+
+        for (thread& worker : m_workers)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+    }
+
+    virtual std::size_t concurrency() const override
+    {
+        return m_workers.size();
+    }
+
+protected:
+    virtual bool _post(task&& t) override
+    {
+        const std::size_t index = worker_index();
+
+        if (index != npos)
+        {
+            m_deques[index]->push(new task(std::move(t)));
+        }
+        else
+        {
+            thread_safe::lock_guard lock(m_injected_mutex);
+
+            if (m_stopping)
+            {
+                return false;
+            }
+            m_injected.push_back(new task(std::move(t)));
+            m_injected_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        _notify_one();
+        return true;
+    }
+
+private:
+    static stdint::u32 _random()
+    {
+        // xorshift, only used to spread the victims
+        static thread_local stdint::u32 state = stdint::u32(std::hash<thread::id>()(this_thread::get_id())) | 1;
+
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    void _notify_one()
+    {
+        // pairs with the fence of a worker going to sleep: either it sees the new task or we see it sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepers.load(std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+
+        {
+            thread_safe::lock_guard lock(m_sleep_mutex);
+
+            if (m_signals < m_workers.size())
+            {
+                m_signals++;
+            }
+        }
+        m_wake.notify_one();
+    }
+
+    bool _pop_injected(task*& t)
+    {
+        if (m_injected_count.load(std::memory_order_relaxed) == 0)
+        {
+            return false;
+        }
+
+        thread_safe::lock_guard lock(m_injected_mutex);
+
+        if (m_injected.empty())
+        {
+            return false;
+        }
+        t = m_injected.front();
+        m_injected.pop_front();
+        m_injected_count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // own deque first, then the injection queue, then the other deques
+    task* _find(std::size_t index)
+    {
+        task* t = nullptr;
+
+        if (index != npos && m_deques[index]->pop(t))
+        {
+            return t;
+        }
+        if (_pop_injected(t))
+        {
+            return t;
+        }
+
+        const std::size_t count = m_deques.size();
+        const std::size_t start = _random() % count;
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            const std::size_t victim = (start + i) % count;
+
+            if (victim != index && m_deques[victim]->steal(t))
+            {
+                return t;
+            }
+        }
+        return nullptr;
+    }
+
+    static void _execute(task* t)
+    {
+        std::unique_ptr<task> owned(t);
+        (*owned)();
+    }
+
+    // runs one queued task if there is one, used by the threads waiting for a task_group
+    bool _run_one()
+    {
+        task* t = _find(worker_index());
+
+        if (t == nullptr)
+        {
+            return false;
+        }
+        _execute(t);
+        return true;
+    }
+
+    void _worker(std::size_t index)
+    {
+        _register_worker(index);
+
+        while (true)
+        {
+            task* t = _find(index);
+
+            for (std::size_t spin = 0; t == nullptr && spin < SILVA_THREADS_WORK_STEALING_SPIN_COUNT; spin++)
+            {
+                this_thread::yield();
+                t = _find(index);
+            }
+
+            if (t == nullptr)
+            {
+                m_sleepers.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                t = _find(index);
+                if (t == nullptr)
+                {
+                    if (m_stopped.load())
+                    {
+                        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+                        return;
+                    }
+
+                    std::unique_lock<thread_safe::mutex> lock(m_sleep_mutex);
+
+                    m_wake.wait(lock, [this]() { return m_signals != 0; });
+                    m_signals--;
+                }
+                m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            if (t != nullptr)
+            {
+                _execute(t);
+            }
+        }
+    }
+};
+
+/**
+ * @brief task_group Fork/join helper on top of a work_stealing_pool
+ * @details wait() runs queued tasks while the group is not done instead of blocking, so recursive groups
+ *          (a task of a group waiting for its own subgroup) never starve the pool.
+ *          The first exception thrown by a task of the group is rethrown by wait().
+ */
+class task_group : public meta::NonCopyMoveable
+{
+private:
+    work_stealing_pool& m_pool;
+    atomic_size_t m_pending;
+
+    thread_safe::mutex m_error_mutex;
+    std::exception_ptr m_error;
+
+public:
+    task_group(work_stealing_pool& pool)
+        : m_pool(pool)
+        , m_pending(0)
+        , m_error_mutex()
+        , m_error()
+    {}
+
+    /**
+     * @brief Waits for the remaining tasks (without rethrowing)
+     */
+    virtual ~task_group() override
+    {
+        _wait();
+    }
+
+    /**
+     * @brief Run f on the pool as part of the group (inline when the pool does not accept tasks anymore)
+     */
+    template<typename F>
+    void run(F&& f)
+    {
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+
+        task wrapped([this, fn = typename std::decay<F>::type(std::forward<F>(f))]() mutable {
+            _invoke(fn);
+        });
+
+        if (!m_pool.post(std::move(wrapped)))
+        {
+            // wrapped is only moved from when queued
+            wrapped();
+        }
+    }
+
+    /**
+     * @brief Wait for all the tasks of the group, helping the pool meanwhile
+     */
+    void wait()
+    {
+        _wait();
+
+        std::exception_ptr error;
+        {
+            thread_safe::lock_guard lock(m_error_mutex);
+            std::swap(error, m_error);
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    template<typename F>
+    void _invoke(F& fn)
+    {
+        try
+        {
+            fn();
+        }
+        catch (...)
+        {
+            thread_safe::lock_guard lock(m_error_mutex);
+
+            if (!m_error)
+            {
+                m_error = std::current_exception();
+            }
+        }
+        m_pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    void _wait()
+    {
+        while (m_pending.load(std::memory_order_acquire) != 0)
+        {
+            if (!m_pool._run_one())
+            {
+                this_thread::yield();
+            }
+        }
+    }
+};
+
+}
+}
+}
+}